@@ -9,8 +9,12 @@
 #include "just/demux/single/SingleDemuxer.h"
 #include "just/demux/segment/SegmentDemuxer.h"
 #include "just/demux/packet/PacketDemuxer.h"
+#include "just/demux/shared/SharedDemuxer.h"
+#include "just/demux/shared/SharedSource.h"
+#include "just/demux/pump/PumpDemuxer.h"
 #ifndef JUST_DISABLE_FFMPEG
 #  include "just/demux/ffmpeg/FFMpegDemuxer.h"
+#  include "just/demux/ffmpeg/FallbackDemuxer.h"
 #endif
 
 using namespace just::avformat::error;
@@ -24,6 +28,8 @@ using namespace just::avformat::error;
 #include <framework/logger/StreamRecord.h>
 
 #include <boost/bind.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
 using namespace boost::system;
 
 FRAMEWORK_LOGGER_DECLARE_MODULE_LEVEL("just.demux.DemuxModule", framework::logger::Debug);
@@ -37,62 +43,122 @@ namespace just
         {
             just::data::MediaBase * media;
             DemuxerBase * demuxer;
+            SharedSource * shared; // demuxer is a reader of it
             framework::string::Url play_link;
             error_code ec;
 
             DemuxInfo()
                 : media(NULL)
                 , demuxer(NULL)
+                , shared(NULL)
             {
             }
-
-            struct Finder
-            {
-                Finder(
-                    DemuxerBase * demuxer)
-                    : demuxer_(demuxer)
-                {
-                }
-
-                bool operator()(
-                    DemuxInfo const * info)
-                {
-                    return info->demuxer == demuxer_;
-                }
-
-            private:
-                DemuxerBase * demuxer_;
-            };
        };
 
+        struct DemuxModule::Shard
+        {
+            boost::mutex mutex;
+            boost::unordered_multimap<std::string, DemuxInfo *> by_link;
+            boost::unordered_map<just::data::MediaBase const *, DemuxInfo *> by_media;
+            boost::unordered_map<DemuxerBase const *, DemuxInfo *> by_demuxer;
+        };
+
         DemuxModule::DemuxModule(
             util::daemon::Daemon & daemon)
             : just::common::CommonModuleBase<DemuxModule>(daemon, "DemuxModule")
+            , config_(daemon.config(), "just.demux")
+            , native_min_scope_(BasicDemuxer::SCOPE_MAX / 2)
+            , share_(false)
+            , share_max_samples_(2000)
+            , share_max_bytes_(8 * 1024 * 1024)
+            , pump_(false)
+            , worker_count_(0)
+            , buffer_budget_(0)
+            , governor_(0)
         {
-            buffer_size_ = 20 * 1024 * 1024;
+            for (size_t i = 0; i < SHARD_COUNT; ++i) {
+                shards_.push_back(new Shard);
+            }
+
+            config_.register_module("Policy")
+                << CONFIG_PARAM_NAME_RDWR("native", native_formats_)
+                << CONFIG_PARAM_NAME_RDWR("ffmpeg", ffmpeg_formats_)
+                << CONFIG_PARAM_NAME_RDWR("native_min_scope", native_min_scope_);
+
+            config_.register_module("Share")
+                << CONFIG_PARAM_NAME_RDWR("enable", share_)
+                << CONFIG_PARAM_NAME_RDWR("max_samples", share_max_samples_)
+                << CONFIG_PARAM_NAME_RDWR("max_bytes", share_max_bytes_);
+
+            config_.register_module("Pump")
+                << CONFIG_PARAM_NAME_RDWR("enable", pump_);
+
+            config_.register_module("Worker")
+                << CONFIG_PARAM_NAME_RDWR("count", worker_count_);
+
+            config_.register_module("Buffer")
+                << CONFIG_PARAM_NAME_RDWR("budget", buffer_budget_);
         }
 
         DemuxModule::~DemuxModule()
         {
-            boost::mutex::scoped_lock lock(mutex_);
-            for (size_t i = demuxers_.size() - 1; i != (size_t)-1; --i) {
-                priv_destroy(demuxers_[i]);
+            std::vector<DemuxerBase *> demuxers;
+            for (size_t i = 0; i < shards_.size(); ++i) {
+                Shard & shard = *shards_[i];
+                boost::mutex::scoped_lock lock(shard.mutex);
+                boost::unordered_map<DemuxerBase const *, DemuxInfo *>::const_iterator iter = shard.by_demuxer.begin();
+                for (; iter != shard.by_demuxer.end(); ++iter) {
+                    demuxers.push_back(iter->second->demuxer);
+                }
+            }
+            for (size_t i = 0; i < demuxers.size(); ++i) {
+                DemuxInfo * info = remove(demuxers[i]);
+                if (info)
+                    priv_destroy(info);
+            }
+            for (size_t i = 0; i < shards_.size(); ++i) {
+                delete shards_[i];
             }
         }
 
+        static bool format_in_list(
+            std::string const & list, 
+            std::string const & format)
+        {
+            if (format.empty())
+                return false;
+            std::string::size_type pos = 0;
+            while ((pos = list.find(format, pos)) != std::string::npos) {
+                std::string::size_type end = pos + format.size();
+                if ((pos == 0 || list[pos - 1] == ',') 
+                    && (end == list.size() || list[end] == ','))
+                    return true;
+                pos = end;
+            }
+            return false;
+        }
+
         bool DemuxModule::startup(
             error_code & ec)
         {
+            if (worker_count_ > 0) {
+                workers_.start(worker_count_, ec);
+            }
             return true;
         }
 
         bool DemuxModule::shutdown(
             error_code & ec)
         {
-            boost::mutex::scoped_lock lock(mutex_);
-            for (size_t i = demuxers_.size() - 1; i != (size_t)-1; --i) {
-                demuxers_[i]->demuxer->cancel(ec);
+            for (size_t i = 0; i < shards_.size(); ++i) {
+                Shard & shard = *shards_[i];
+                boost::mutex::scoped_lock lock(shard.mutex);
+                boost::unordered_map<DemuxerBase const *, DemuxInfo *>::const_iterator iter = shard.by_demuxer.begin();
+                for (; iter != shard.by_demuxer.end(); ++iter) {
+                    iter->second->demuxer->cancel(ec);
+                }
             }
+            workers_.stop();
             return true;
         }
 
@@ -109,14 +175,12 @@ namespace just
             DemuxerBase * demuxer, 
             error_code & ec)
         {
-            boost::mutex::scoped_lock lock(mutex_);
-            std::vector<DemuxInfo *>::const_iterator iter = 
-                std::find_if(demuxers_.begin(), demuxers_.end(), DemuxInfo::Finder(demuxer));
-            //assert(iter != demuxers_.end());
-            if (iter == demuxers_.end()) {
+            // destroy outside of index locks
+            DemuxInfo * info = remove(demuxer);
+            if (info == NULL) {
                 ec = framework::system::logic_error::item_not_exist;
             } else {
-                priv_destroy(*iter);
+                priv_destroy(info);
                 ec.clear();
             }
             return !ec;
@@ -125,12 +189,12 @@ namespace just
         DemuxerBase * DemuxModule::find(
             framework::string::Url const & play_link)
         {
-            boost::mutex::scoped_lock lock(mutex_);
-            std::vector<DemuxInfo *>::const_iterator iter = demuxers_.begin();
-            for (; iter != demuxers_.end(); ++iter) {
-                if ((*iter)->play_link == play_link) {
-                    return (*iter)->demuxer;
-                }
+            std::string link = play_link.to_string();
+            Shard & shard = link_shard(link);
+            boost::mutex::scoped_lock lock(shard.mutex);
+            boost::unordered_multimap<std::string, DemuxInfo *>::const_iterator iter = shard.by_link.find(link);
+            if (iter != shard.by_link.end()) {
+                return iter->second->demuxer;
             }
             return NULL;
         }
@@ -138,25 +202,22 @@ namespace just
         DemuxerBase * DemuxModule::find(
             just::data::MediaBase const & media)
         {
-            boost::mutex::scoped_lock lock(mutex_);
-            std::vector<DemuxInfo *>::const_iterator iter = demuxers_.begin();
-            for (; iter != demuxers_.end(); ++iter) {
-                if ((*iter)->media == &media) {
-                    return (*iter)->demuxer;
-                }
+            Shard & shard = media_shard(&media);
+            boost::mutex::scoped_lock lock(shard.mutex);
+            boost::unordered_map<just::data::MediaBase const *, DemuxInfo *>::const_iterator iter = shard.by_media.find(&media);
+            if (iter != shard.by_media.end()) {
+                return iter->second->demuxer;
             }
             return NULL;
         }
 
-        DemuxModule::DemuxInfo * DemuxModule::priv_create(
-            framework::string::Url const & play_link, 
+        DemuxerBase * DemuxModule::create_demuxer(
+            framework::string::Url const & playlink, 
             framework::string::Url const & config, 
+            just::data::MediaBase *& media, 
             error_code & ec)
         {
-            framework::string::Url playlink(play_link);
-            if (!just::common::decode_url(playlink, ec))
-                return NULL;
-            just::data::MediaBase * media = just::data::MediaBase::create(io_svc(), playlink, ec);
+            media = just::data::MediaBase::create(io_svc(), playlink, ec);
             DemuxerBase * demuxer = NULL;
             if (media != NULL) {
                 just::data::MediaBasicInfo info;
@@ -167,29 +228,181 @@ namespace just
                         demuxer = PacketDemuxerFactory::create(info.format_type, io_svc(), *(just::data::PacketMedia *)media, ec);
                     } else {
 #ifndef JUST_DISABLE_FFMPEG
-                        if (framework::process::get_environment("JUST_DISABLE_FFMPEG", "no") != "yes")
-                            demuxer = new FFMpegDemuxer(io_svc(), *media);
+                        if (framework::process::get_environment("JUST_DISABLE_FFMPEG", "no") != "yes") {
+                            if (format_in_list(ffmpeg_formats_, info.format_type)) {
+                                demuxer = new FFMpegDemuxer(io_svc(), *media);
+                            } else if (!format_in_list(native_formats_, info.format_type)) {
+                                // choose after probing real bytes, format hint alone is not trusted
+                                SingleDemuxer * single = new SingleDemuxer(io_svc(), *media);
+                                setup_demuxer(*single, config);
+                                demuxer = new FallbackDemuxer(*single, *media, 
+                                    boost::bind(&DemuxModule::native_ok, this, _1, _2), 
+                                    boost::bind(&DemuxModule::setup_demuxer, this, _1, config));
+                            }
+                        }
 #endif
                         if (demuxer == NULL)
                             demuxer = new SingleDemuxer(io_svc(), *media);
                     }
                     if (demuxer) {
-                        just::common::apply_config(demuxer->get_config(), config, "demux.");
+                        setup_demuxer(*demuxer, config);
+                    }
+                }
+            }
+            return demuxer;
+        }
+
+        void DemuxModule::setup_demuxer(
+            DemuxerBase & demuxer, 
+            framework::string::Url const & config)
+        {
+            just::common::apply_config(demuxer.get_config(), config, "demux.");
+            Demuxer * demuxer2 = dynamic_cast<Demuxer *>(&demuxer);
+            // opt in, without a budget every demuxer keeps its own buffer size
+            if (demuxer2 && buffer_budget_) {
+                governor_.set_budget(buffer_budget_);
+                demuxer2->set_governor(&governor_);
+            }
+            if (demuxer2 && workers_.size()) {
+                demuxer2->set_worker(workers_.io_svc());
+            }
+        }
+
+        SharedSource * DemuxModule::attach_shared(
+            framework::string::Url const & playlink, 
+            framework::string::Url const & config, 
+            DemuxerBase *& demuxer, 
+            just::data::MediaBase *& media, 
+            error_code & ec)
+        {
+            std::string link = playlink.to_string();
+            {
+                boost::mutex::scoped_lock lock(shared_mutex_);
+                std::map<std::string, SharedSource *>::const_iterator iter = shared_sources_.find(link);
+                if (iter != shared_sources_.end()) {
+                    if (!iter->second->shareable()) {
+                        // not live, caller opens its own
+                        ec.clear();
+                        return NULL;
+                    }
+                    iter->second->attach();
+                    ec.clear();
+                    return iter->second;
+                }
+            }
+            // create upstream without lock, other may win the race
+            demuxer = create_demuxer(playlink, config, media, ec);
+            if (demuxer == NULL) {
+                if (media)
+                    delete media;
+                media = NULL;
+                return NULL;
+            }
+            // decide before any reader attaches, vod readers seek and need their own upstream
+            just::data::MediaBasicInfo info;
+            error_code ec1;
+            if (!media->get_basic_info(info, ec1) || info.type != just::data::MediaInfo::live) {
+                ec.clear();
+                return NULL;
+            }
+            SharedSource * shared = new SharedSource(demuxer, media, share_max_samples_, share_max_bytes_);
+            demuxer = NULL;
+            media = NULL;
+            SharedSource * other = NULL;
+            {
+                boost::mutex::scoped_lock lock(shared_mutex_);
+                std::map<std::string, SharedSource *>::const_iterator iter = shared_sources_.find(link);
+                if (iter == shared_sources_.end()) {
+                    shared_sources_.insert(std::make_pair(link, shared));
+                    shared->attach();
+                    LOG_INFO("[attach_shared] new upstream: " << link);
+                } else {
+                    other = iter->second;
+                    other->attach();
+                }
+            }
+            if (other) {
+                delete shared;
+                shared = other;
+            }
+            ec.clear();
+            return shared;
+        }
+
+        void DemuxModule::detach_shared(
+            SharedSource * shared)
+        {
+            {
+                boost::mutex::scoped_lock lock(shared_mutex_);
+                if (shared->detach() > 0)
+                    return;
+                std::map<std::string, SharedSource *>::iterator iter = shared_sources_.begin();
+                for (; iter != shared_sources_.end(); ++iter) {
+                    if (iter->second == shared) {
+                        shared_sources_.erase(iter);
+                        break;
                     }
                 }
             }
+            // closes upstream
+            delete shared;
+        }
+
+        DemuxModule::DemuxInfo * DemuxModule::priv_create(
+            framework::string::Url const & play_link, 
+            framework::string::Url const & config, 
+            error_code & ec)
+        {
+            framework::string::Url playlink(play_link);
+            if (!just::common::decode_url(playlink, ec))
+                return NULL;
+            just::data::MediaBase * media = NULL;
+            SharedSource * shared = NULL;
+            DemuxerBase * demuxer = NULL;
+            if (share_) {
+                shared = attach_shared(playlink, config, demuxer, media, ec);
+                if (shared) {
+                    demuxer = new SharedDemuxer(io_svc(), *shared);
+                    just::common::apply_config(demuxer->get_config(), config, "demux.");
+                }
+            }
+            if (shared == NULL && !ec) {
+                if (demuxer == NULL)
+                    demuxer = create_demuxer(playlink, config, media, ec);
+                if (demuxer && pump_) {
+                    demuxer = new PumpDemuxer(*demuxer);
+                    just::common::apply_config(demuxer->get_config(), config, "demux.");
+                }
+            }
             if (demuxer) {
                 DemuxInfo * info = new DemuxInfo;
                 info->media = media;
                 info->demuxer = demuxer;
+                info->shared = shared;
                 info->play_link = playlink;
-                boost::mutex::scoped_lock lock(mutex_);
-                demuxers_.push_back(info);
+                insert(info);
                 return info;
             }
             return NULL;
         }
 
+        bool DemuxModule::native_ok(
+            std::string const & format, 
+            boost::uint32_t scope)
+        {
+            // format here comes from probe, may differ from hint checked in create_demuxer
+            bool native = false;
+            if (format_in_list(native_formats_, format)) {
+                native = true;
+            } else if (format_in_list(ffmpeg_formats_, format)) {
+                native = false;
+            } else if (BasicDemuxerFactory::is_support(format)) {
+                native = scope >= native_min_scope_;
+            }
+            LOG_DEBUG("[native_ok] format: " << format << ", scope: " << scope << ", native: " << native);
+            return native;
+        }
+
         void DemuxModule::priv_destroy(
             DemuxInfo * info)
         {
@@ -198,17 +411,115 @@ namespace just
                 delete demuxer;
             if (info->media)
                 delete info->media;
-            demuxers_.erase(
-                std::remove(demuxers_.begin(), demuxers_.end(), info), 
-                demuxers_.end());
+            if (info->shared)
+                detach_shared(info->shared);
             delete info;
             info = NULL;
         }
 
+        DemuxModule::Shard & DemuxModule::link_shard(
+            std::string const & link)
+        {
+            return *shards_[boost::hash<std::string>()(link) % shards_.size()];
+        }
+
+        DemuxModule::Shard & DemuxModule::media_shard(
+            just::data::MediaBase const * media)
+        {
+            return *shards_[boost::hash<just::data::MediaBase const *>()(media) % shards_.size()];
+        }
+
+        DemuxModule::Shard & DemuxModule::demuxer_shard(
+            DemuxerBase const * demuxer)
+        {
+            return *shards_[boost::hash<DemuxerBase const *>()(demuxer) % shards_.size()];
+        }
+
+        void DemuxModule::insert(
+            DemuxInfo * info)
+        {
+            // one shard lock at a time, never nested
+            {
+                Shard & shard = demuxer_shard(info->demuxer);
+                boost::mutex::scoped_lock lock(shard.mutex);
+                shard.by_demuxer[info->demuxer] = info;
+            }
+            if (info->media) {
+                Shard & shard = media_shard(info->media);
+                boost::mutex::scoped_lock lock(shard.mutex);
+                shard.by_media[info->media] = info;
+            }
+            {
+                std::string link = info->play_link.to_string();
+                Shard & shard = link_shard(link);
+                boost::mutex::scoped_lock lock(shard.mutex);
+                shard.by_link.insert(std::make_pair(link, info));
+            }
+        }
+
+        DemuxModule::DemuxInfo * DemuxModule::remove(
+            DemuxerBase * demuxer)
+        {
+            DemuxInfo * info = NULL;
+            {
+                Shard & shard = demuxer_shard(demuxer);
+                boost::mutex::scoped_lock lock(shard.mutex);
+                boost::unordered_map<DemuxerBase const *, DemuxInfo *>::iterator iter = shard.by_demuxer.find(demuxer);
+                if (iter == shard.by_demuxer.end())
+                    return NULL;
+                info = iter->second;
+                shard.by_demuxer.erase(iter);
+            }
+            if (info->media) {
+                Shard & shard = media_shard(info->media);
+                boost::mutex::scoped_lock lock(shard.mutex);
+                shard.by_media.erase(info->media);
+            }
+            {
+                std::string link = info->play_link.to_string();
+                Shard & shard = link_shard(link);
+                boost::mutex::scoped_lock lock(shard.mutex);
+                typedef boost::unordered_multimap<std::string, DemuxInfo *>::iterator iterator;
+                std::pair<iterator, iterator> range = shard.by_link.equal_range(link);
+                for (; range.first != range.second; ++range.first) {
+                    if (range.first->second == info) {
+                        shard.by_link.erase(range.first);
+                        break;
+                    }
+                }
+            }
+            return info;
+        }
+
         void DemuxModule::set_download_buffer_size(
             boost::uint32_t buffer_size)
         {
-            buffer_size_ = buffer_size;
+            // taken by demuxers created from now on
+            buffer_budget_ = buffer_size;
+        }
+
+        void DemuxModule::get_buffer_stat(
+            BufferGovernor::Stat & stat)
+        {
+            governor_.stat(stat);
+        }
+
+        void DemuxModule::get_latency_stat(
+            LatencyStat & stat)
+        {
+            stat = LatencyStat();
+            boost::system::error_code ec;
+            for (size_t i = 0; i < shards_.size(); ++i) {
+                Shard & shard = *shards_[i];
+                boost::mutex::scoped_lock lock(shard.mutex);
+                boost::unordered_map<DemuxerBase const *, DemuxInfo *>::const_iterator iter = shard.by_demuxer.begin();
+                for (; iter != shard.by_demuxer.end(); ++iter) {
+                    LatencyStat stat1;
+                    if (iter->second->demuxer->get_latency_stat(stat1, ec)) {
+                        stat.merge(stat1);
+                    }
+                }
+            }
         }
 
     } // namespace demux
@@ -3,7 +3,12 @@
 #ifndef _JUST_DEMUX_DEMUX_MODULE_H_
 #define _JUST_DEMUX_DEMUX_MODULE_H_
 
+#include "just/demux/base/BufferGovernor.h"
+#include "just/demux/base/LatencyHistogram.h"
+#include "just/demux/base/WorkerPool.h"
+
 #include <framework/string/Url.h>
+#include <framework/configure/Config.h>
 
 #include <boost/thread/mutex.hpp>
 
@@ -18,6 +23,7 @@ namespace just
     {
 
         class DemuxerBase;
+        class SharedSource;
         class Strategy;
 
         class DemuxModule
@@ -37,9 +43,18 @@ namespace just
                 boost::system::error_code & ec);
 
         public:
+            // total bytes for all demux buffers, same as Buffer.budget config, 0 turns governor off
             void set_download_buffer_size(
                 boost::uint32_t buffer_size);
 
+            // memory pressure of all demux buffers
+            void get_buffer_stat(
+                BufferGovernor::Stat & stat);
+
+            // latencies of all demuxers merged
+            void get_latency_stat(
+                LatencyStat & stat);
+
         public:
             DemuxerBase * create(
                 framework::string::Url const & play_link, 
@@ -58,8 +73,56 @@ namespace just
 
         private:
             struct DemuxInfo;
+            struct Shard;
+
+            static size_t const SHARD_COUNT = 16;
+
+            Shard & link_shard(
+                std::string const & link);
+
+            Shard & media_shard(
+                just::data::MediaBase const * media);
+
+            Shard & demuxer_shard(
+                DemuxerBase const * demuxer);
+
+            void insert(
+                DemuxInfo * info);
+
+            // remove from all indexes, return NULL if not exist
+            DemuxInfo * remove(
+                DemuxerBase * demuxer);
 
         private:
+            // probe check of SingleDemuxer, false to fall back to FFMpegDemuxer
+            // scope is 0 when bytes are not recognized and only format hint is left
+            bool native_ok(
+                std::string const & format, 
+                boost::uint32_t scope);
+
+            // config, governor and worker for a new demuxer
+            void setup_demuxer(
+                DemuxerBase & demuxer, 
+                framework::string::Url const & config);
+
+            DemuxerBase * create_demuxer(
+                framework::string::Url const & play_link, 
+                framework::string::Url const & config, 
+                just::data::MediaBase *& media, 
+                boost::system::error_code & ec);
+
+            // find or create upstream of play link, with one more reader attached
+            // only live links are shared, for others the created demuxer and media are given back
+            SharedSource * attach_shared(
+                framework::string::Url const & play_link, 
+                framework::string::Url const & config, 
+                DemuxerBase *& demuxer, 
+                just::data::MediaBase *& media, 
+                boost::system::error_code & ec);
+
+            void detach_shared(
+                SharedSource * shared);
+
             DemuxInfo * priv_create(
                 framework::string::Url const & play_link, 
                 framework::string::Url const & config, 
@@ -69,12 +132,28 @@ namespace just
                 DemuxInfo * info);
 
         private:
-            // 
-            boost::uint32_t buffer_size_;
+            // config
+            framework::configure::Config config_;
+            std::string native_formats_; // always use native demuxer, comma separated
+            std::string ffmpeg_formats_; // always use ffmpeg, comma separated
+            boost::uint32_t native_min_scope_; // min probe scope for native demuxer
+            bool share_; // one upstream demuxer for same play link
+            boost::uint32_t share_max_samples_;
+            boost::uint32_t share_max_bytes_;
+            bool pump_; // demux on a dedicated thread per demuxer
+            boost::uint32_t worker_count_; // extra threads for demux work, 0 for daemon threads only
 
         private:
-            std::vector<DemuxInfo *> demuxers_;
-            boost::mutex mutex_;
+            // config, bytes for all demux buffers, 0 for no governor
+            // admission control only: buffers are sized when created and never shrunk for later ones,
+            // once budget is used up new demuxers fail to open with no_buffer_space
+            boost::uint32_t buffer_budget_;
+            BufferGovernor governor_;
+            WorkerPool workers_;
+            // each index is sharded by hash of its own key
+            std::vector<Shard *> shards_;
+            std::map<std::string, SharedSource *> shared_sources_;
+            boost::mutex shared_mutex_;
         };
 
     } // namespace demux
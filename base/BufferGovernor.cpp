@@ -0,0 +1,127 @@
+// BufferGovernor.cpp
+
+#include "just/demux/Common.h"
+#include "just/demux/base/BufferGovernor.h"
+
+#include <framework/logger/Logger.h>
+#include <framework/logger/StreamRecord.h>
+
+FRAMEWORK_LOGGER_DECLARE_MODULE_LEVEL("just.demux.BufferGovernor", framework::logger::Debug);
+
+namespace just
+{
+    namespace demux
+    {
+
+        BufferGovernor::BufferGovernor(
+            boost::uint64_t budget)
+            : budget_(budget)
+            , used_(0)
+            , next_id_(0)
+        {
+        }
+
+        void BufferGovernor::set_budget(
+            boost::uint64_t budget)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            budget_ = budget;
+        }
+
+        boost::uint64_t BufferGovernor::weight(
+            boost::uint32_t priority, 
+            boost::uint32_t bitrate, 
+            bool active)
+        {
+            // unknown bitrate counts as 1Mbps
+            boost::uint64_t w = (boost::uint64_t)(priority ? priority : 1)
+                * ((bitrate ? bitrate : 1000000) / 1000 + 1);
+            return active ? w * 4 : w;
+        }
+
+        size_t BufferGovernor::acquire(
+            boost::uint32_t priority, 
+            boost::uint32_t bitrate, 
+            boost::uint32_t wanted, 
+            boost::uint32_t & capacity, 
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            boost::uint64_t w = weight(priority, bitrate, true);
+            boost::uint64_t total = w;
+            std::map<size_t, Lease>::const_iterator iter = leases_.begin();
+            for (; iter != leases_.end(); ++iter) {
+                total += weight(iter->second.priority, iter->second.bitrate, iter->second.active);
+            }
+            boost::uint64_t share = budget_ * w / total;
+            boost::uint64_t avail = budget_ > used_ ? budget_ - used_ : 0;
+            boost::uint64_t cap = wanted;
+            if (cap > share)
+                cap = share;
+            if (cap > avail)
+                cap = avail;
+            boost::uint64_t min_cap = wanted < MIN_CAPACITY ? wanted : MIN_CAPACITY;
+            if (cap < min_cap) {
+                if (avail < min_cap) {
+                    ++stat_.refused;
+                    LOG_WARN("[acquire] budget exhausted, budget: " << budget_ << ", used: " << used_ << ", leases: " << leases_.size());
+                    ec = boost::asio::error::no_buffer_space;
+                    return 0;
+                }
+                cap = min_cap;
+            }
+            if (cap < wanted) {
+                ++stat_.reduced;
+                LOG_DEBUG("[acquire] reduced, wanted: " << wanted << ", granted: " << cap);
+            }
+            Lease & lease = leases_[++next_id_];
+            lease.priority = priority;
+            lease.bitrate = bitrate;
+            lease.capacity = (boost::uint32_t)cap;
+            lease.active = true;
+            used_ += cap;
+            capacity = (boost::uint32_t)cap;
+            ec.clear();
+            return next_id_;
+        }
+
+        void BufferGovernor::release(
+            size_t lease)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            std::map<size_t, Lease>::iterator iter = leases_.find(lease);
+            if (iter != leases_.end()) {
+                used_ -= iter->second.capacity;
+                leases_.erase(iter);
+            }
+        }
+
+        void BufferGovernor::set_active(
+            size_t lease, 
+            bool active)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            std::map<size_t, Lease>::iterator iter = leases_.find(lease);
+            if (iter != leases_.end()) {
+                iter->second.active = active;
+            }
+        }
+
+        void BufferGovernor::stat(
+            Stat & stat)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            stat = stat_;
+            stat.budget = budget_;
+            stat.used = used_;
+            stat.leases = leases_.size();
+            stat.paused = 0;
+            std::map<size_t, Lease>::const_iterator iter = leases_.begin();
+            for (; iter != leases_.end(); ++iter) {
+                if (!iter->second.active)
+                    ++stat.paused;
+            }
+        }
+
+    } // namespace demux
+} // namespace just
@@ -0,0 +1,98 @@
+// BufferGovernor.h
+
+#ifndef _JUST_DEMUX_BASE_BUFFER_GOVERNOR_H_
+#define _JUST_DEMUX_BASE_BUFFER_GOVERNOR_H_
+
+#include <boost/thread/mutex.hpp>
+
+#include <map>
+
+namespace just
+{
+    namespace demux
+    {
+
+        // Module wide budget of demux buffer memory
+        // each buffer gets a share weighted by priority and bitrate when created,
+        // paused ones weigh less in later grants, but keep what they got until released,
+        // data buffers can't shrink in place, so this is admission control, not rebalancing:
+        // a burst of opens may see no_buffer_space until earlier leases are released
+        class BufferGovernor
+        {
+        public:
+            struct Stat
+            {
+                Stat()
+                    : budget(0)
+                    , used(0)
+                    , leases(0)
+                    , paused(0)
+                    , reduced(0)
+                    , refused(0)
+                {
+                }
+
+                boost::uint64_t budget;
+                boost::uint64_t used;
+                size_t leases;
+                size_t paused;
+                size_t reduced; // granted less than wanted
+                size_t refused; // budget exhausted
+            };
+
+        public:
+            BufferGovernor(
+                boost::uint64_t budget);
+
+        public:
+            void set_budget(
+                boost::uint64_t budget);
+
+            // return lease id, 0 if refused
+            size_t acquire(
+                boost::uint32_t priority, 
+                boost::uint32_t bitrate, 
+                boost::uint32_t wanted, 
+                boost::uint32_t & capacity, 
+                boost::system::error_code & ec);
+
+            void release(
+                size_t lease);
+
+            void set_active(
+                size_t lease, 
+                bool active);
+
+            void stat(
+                Stat & stat);
+
+        public:
+            static boost::uint32_t const MIN_CAPACITY = 1024 * 1024;
+
+        private:
+            struct Lease
+            {
+                boost::uint32_t priority;
+                boost::uint32_t bitrate;
+                boost::uint32_t capacity;
+                bool active;
+            };
+
+            static boost::uint64_t weight(
+                boost::uint32_t priority, 
+                boost::uint32_t bitrate, 
+                bool active);
+
+        private:
+            boost::mutex mutex_;
+            boost::uint64_t budget_;
+            boost::uint64_t used_;
+            size_t next_id_;
+            std::map<size_t, Lease> leases_;
+            Stat stat_;
+        };
+
+    } // namespace demux
+} // namespace just
+
+#endif // _JUST_DEMUX_BASE_BUFFER_GOVERNOR_H_
@@ -91,6 +91,27 @@ namespace just
             return demuxer_->get_data_stat(stat, ec);
         }
 
+        bool CustomDemuxer::peek_stream_status(
+            StreamStatus & info, 
+            boost::system::error_code & ec) const
+        {
+            return demuxer_->peek_stream_status(info, ec);
+        }
+
+        bool CustomDemuxer::get_latency_stat(
+            LatencyStat & stat, 
+            boost::system::error_code & ec) const
+        {
+            return demuxer_->get_latency_stat(stat, ec);
+        }
+
+        bool CustomDemuxer::get_track_stat(
+            std::vector<TrackStat> & stats, 
+            boost::system::error_code & ec) const
+        {
+            return demuxer_->get_track_stat(stats, ec);
+        }
+
         boost::system::error_code CustomDemuxer::reset(
             boost::system::error_code & ec)
         {
@@ -123,5 +144,25 @@ namespace just
             return demuxer_->get_sample(sample, ec);
         }
 
+        size_t CustomDemuxer::get_samples(
+            Sample * samples, 
+            size_t max_count, 
+            size_t max_bytes, 
+            boost::system::error_code & ec)
+        {
+            return demuxer_->get_samples(samples, max_count, max_bytes, ec);
+        }
+
+        void CustomDemuxer::async_prepare_data(
+            sample_response_type const & resp)
+        {
+            Demuxer * demuxer = dynamic_cast<Demuxer *>(demuxer_);
+            if (demuxer) {
+                demuxer->async_prepare_data(resp);
+            } else {
+                Demuxer::async_prepare_data(resp);
+            }
+        }
+
     } // namespace demux
 } // namespace just
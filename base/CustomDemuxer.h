@@ -59,6 +59,18 @@ namespace just
                 DataStat & stat, 
                 boost::system::error_code & ec) const;
 
+            virtual bool peek_stream_status(
+                StreamStatus & info, 
+                boost::system::error_code & ec) const;
+
+            virtual bool get_latency_stat(
+                LatencyStat & stat, 
+                boost::system::error_code & ec) const;
+
+            virtual bool get_track_stat(
+                std::vector<TrackStat> & stats, 
+                boost::system::error_code & ec) const;
+
         public:
             virtual boost::system::error_code reset(
                 boost::system::error_code & ec);
@@ -77,6 +89,16 @@ namespace just
                 Sample & sample, 
                 boost::system::error_code & ec);
 
+            virtual size_t get_samples(
+                Sample * samples, 
+                size_t max_count, 
+                size_t max_bytes, 
+                boost::system::error_code & ec);
+
+        protected:
+            virtual void async_prepare_data(
+                sample_response_type const & resp);
+
         protected:
             void attach(DemuxerBase & demuxer)
             {
@@ -91,6 +113,11 @@ namespace just
                 return *demuxer;
             }
 
+            DemuxerBase * attached() const
+            {
+                return demuxer_;
+            }
+
         private:
             DemuxerBase * demuxer_;
         };
@@ -4,6 +4,12 @@
 #include "just/demux/base/DemuxStatistic.h"
 #include "just/demux/base/Demuxer.h"
 
+#ifdef BOOST_WINDOWS_API
+#  include <windows.h>
+#else
+#  include <time.h>
+#endif
+
 namespace just
 {
     namespace demux
@@ -12,13 +18,245 @@ namespace just
         DemuxStatistic::DemuxStatistic(
             DemuxerBase & demuxer)
             : demuxer_(demuxer)
+            , open_phase_(phase_count)
+            , open_bytes_(0)
+            , open_wait_(boost::uint32_t(-1))
+            , track_count_(0)
+            , play_time_(0)
+        {
+            memset(latency_begs_, 0, sizeof(latency_begs_));
+        }
+
+        void DemuxStatistic::latency_stat(
+            LatencyStat & stat) const
+        {
+            for (size_t i = 0; i < LatencyStat::type_count; ++i) {
+                latencies_[i].snapshot(stat.latencies[i]);
+            }
+        }
+
+        void DemuxStatistic::open_phase_beg(
+            OpenPhaseEnum phase, 
+            boost::uint64_t bytes)
+        {
+            if (phase == phase_media) {
+                open_clock_ = framework::timer::TimeCounter();
+                for (size_t i = 0; i < phase_count; ++i) {
+                    open_phases_[i] = OpenPhaseStat();
+                }
+                open_phase_ = phase_count;
+            }
+            open_phase_end(bytes);
+            open_phase_ = phase;
+            open_phases_[phase] = OpenPhaseStat();
+            open_phases_[phase].beg = (boost::uint32_t)open_clock_.elapse();
+            open_bytes_ = bytes;
+        }
+
+        void DemuxStatistic::open_phase_end(
+            boost::uint64_t bytes)
+        {
+            if (open_phase_ == phase_count)
+                return;
+            open_wait_end();
+            OpenPhaseStat & stat = open_phases_[open_phase_];
+            stat.elapse = (boost::uint32_t)open_clock_.elapse() - stat.beg;
+            stat.bytes = bytes > open_bytes_ ? bytes - open_bytes_ : 0;
+            open_phase_ = phase_count;
+        }
+
+        void DemuxStatistic::open_wait_beg()
+        {
+            if (open_phase_ == phase_count || open_wait_ != boost::uint32_t(-1))
+                return;
+            open_wait_ = (boost::uint32_t)open_clock_.elapse();
+        }
+
+        void DemuxStatistic::open_wait_end()
+        {
+            if (open_phase_ == phase_count || open_wait_ == boost::uint32_t(-1))
+                return;
+            OpenPhaseStat & stat = open_phases_[open_phase_];
+            stat.wait += (boost::uint32_t)open_clock_.elapse() - open_wait_;
+            ++stat.wait_count;
+            open_wait_ = boost::uint32_t(-1);
+        }
+
+        void DemuxStatistic::open_phase_merge(
+            DemuxStatistic const & inner)
+        {
+            OpenPhaseStat const & stream = inner.open_phases_[phase_stream];
+            if (stream.elapse == 0 && stream.bytes == 0)
+                return;
+            OpenPhaseStat & header = open_phases_[phase_header];
+            OpenPhaseStat & stat = open_phases_[phase_stream];
+            stat = stream;
+            if (stat.elapse > header.elapse)
+                stat.elapse = header.elapse;
+            header.elapse -= stat.elapse;
+            header.bytes = header.bytes > stat.bytes ? header.bytes - stat.bytes : 0;
+            stat.beg = header.beg + header.elapse;
+            // inner demuxer never waits itself, waits stay in header phase
+            stat.wait = 0;
+            stat.wait_count = 0;
+        }
+
+        boost::uint64_t DemuxStatistic::latency_now()
+        {
+            // not wall clock, which jumps with ntp or user changes
+#ifdef BOOST_WINDOWS_API
+            static LARGE_INTEGER freq = {0};
+            if (freq.QuadPart == 0)
+                QueryPerformanceFrequency(&freq);
+            LARGE_INTEGER count;
+            QueryPerformanceCounter(&count);
+            boost::uint64_t now = (boost::uint64_t)(count.QuadPart / freq.QuadPart * 1000000 
+                + count.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart);
+#else
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            boost::uint64_t now = (boost::uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+            static boost::uint64_t const epoch = now;
+            return now - epoch + 1; // 0 is for not marked
+        }
+
+        void DemuxStatistic::latency_mark(
+            LatencyStat::TypeEnum type)
         {
+            if (type == LatencyStat::seek) {
+                // blocking before seek is not what user waits for
+                latency_begs_[LatencyStat::block] = 0;
+            } else if (latency_begs_[type]) {
+                return;
+            }
+            latency_begs_[type] = latency_now();
+        }
+
+        void DemuxStatistic::latency_end(
+            boost::uint64_t beg, 
+            boost::system::error_code const & ec)
+        {
+            boost::uint64_t now = latency_now();
+            latencies_[LatencyStat::get_sample].record(now - beg);
+            if (ec) {
+                if (ec == boost::asio::error::would_block)
+                    latency_mark(LatencyStat::block);
+                return;
+            }
+            for (size_t i = LatencyStat::seek; i < LatencyStat::type_count; ++i) {
+                if (latency_begs_[i]) {
+                    latencies_[i].record(now - latency_begs_[i]);
+                    latency_begs_[i] = 0;
+                }
+            }
+        }
+
+        void DemuxStatistic::track_stat(
+            std::vector<TrackStat> & stats) const
+        {
+            size_t count = track_count_.load(boost::memory_order_acquire);
+            stats.resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                if (!track_snapshots_[i].load(stats[i]))
+                    stats[i] = TrackStat();
+            }
+        }
+
+        void DemuxStatistic::track_open(
+            size_t count)
+        {
+            if (tracks_.size() < count)
+                tracks_.resize(count);
+            for (size_t i = 0; i < tracks_.size(); ++i) {
+                track_publish(i);
+            }
+        }
+
+        void DemuxStatistic::track_seek()
+        {
+            play_time_.store(0, boost::memory_order_relaxed);
+            for (size_t i = 0; i < tracks_.size(); ++i) {
+                tracks_[i].first_time = boost::uint64_t(-1);
+                tracks_[i].last_time = boost::uint64_t(-1);
+                tracks_[i].last_sync_time = boost::uint64_t(-1);
+                track_publish(i);
+            }
+        }
+
+        void DemuxStatistic::track_publish(
+            size_t itrack)
+        {
+            if (itrack >= MAX_TRACKS)
+                return;
+            track_snapshots_[itrack].store(tracks_[itrack]);
+            if (itrack >= track_count_.load(boost::memory_order_relaxed))
+                track_count_.store(itrack + 1, boost::memory_order_release);
+        }
+
+        void DemuxStatistic::track_delta(
+            TrackStat & stat, 
+            boost::uint64_t time)
+        {
+            if (time < stat.last_time) {
+                ++stat.back_count;
+                return;
+            }
+            boost::uint32_t delta = (boost::uint32_t)(time - stat.last_time);
+            if (delta > stat.max_delta)
+                stat.max_delta = delta;
+            if (delta > TrackStat::GAP_MIN)
+                ++stat.gap_count;
+        }
+
+        void DemuxStatistic::track_sync(
+            TrackStat & stat, 
+            boost::uint64_t time)
+        {
+            if (stat.sync_count && stat.last_sync_time != boost::uint64_t(-1) && time > stat.last_sync_time) {
+                boost::uint32_t interval = (boost::uint32_t)(time - stat.last_sync_time);
+                stat.sync_interval += interval;
+                ++stat.sync_interval_count;
+                if (interval > stat.max_sync_interval)
+                    stat.max_sync_interval = interval;
+            }
+            ++stat.sync_count;
+            stat.last_sync_time = time;
         }
 
         void DemuxStatistic::update_stat(
             boost::system::error_code & ec)
         {
             demuxer_.get_stream_status(*this, ec);
+            // get_stream_status is costly, so publish only here on buffer events
+            StatusSnapshot snapshot;
+            snapshot.byte_beg = byte_range.beg;
+            snapshot.byte_end = byte_range.end;
+            snapshot.byte_pos = byte_range.pos;
+            snapshot.byte_buf = byte_range.buf;
+            snapshot.time_beg = time_range.beg;
+            snapshot.time_end = time_range.end;
+            snapshot.time_pos = time_range.pos;
+            snapshot.time_buf = time_range.buf;
+            status_snapshot_.store(snapshot);
+        }
+
+        bool DemuxStatistic::status_snapshot(
+            StreamStatus & status) const
+        {
+            StatusSnapshot snapshot;
+            if (!status_snapshot_.load(snapshot))
+                return false;
+            status.byte_range.beg = snapshot.byte_beg;
+            status.byte_range.end = snapshot.byte_end;
+            status.byte_range.pos = snapshot.byte_pos;
+            status.byte_range.buf = snapshot.byte_buf;
+            status.time_range.beg = snapshot.time_beg;
+            status.time_range.end = snapshot.time_end;
+            boost::uint64_t play_time = play_time_.load(boost::memory_order_relaxed);
+            status.time_range.pos = play_time > snapshot.time_pos ? play_time : snapshot.time_pos;
+            status.time_range.buf = snapshot.time_buf;
+            return true;
         }
 
     }
@@ -4,27 +4,236 @@
 #define _JUST_DEMUX_BASE_DEMUX_STATISTIC_H_
 
 #include "just/demux/base/DemuxBase.h"
+#include "just/demux/base/LatencyHistogram.h"
+#include "just/demux/base/SeqLock.h"
 
 #include <just/avbase/StreamStatistic.h>
 
+#include <framework/timer/TimeCounter.h>
+
 namespace just
 {
     namespace demux
     {
 
+        struct TrackStat
+        {
+            TrackStat()
+                : sample_count(0)
+                , bytes(0)
+                , sync_count(0)
+                , first_time(0)
+                , first_bytes(0)
+                , last_time(0)
+                , last_sync_time(0)
+                , sync_interval(0)
+                , sync_interval_count(0)
+                , max_sync_interval(0)
+                , max_delta(0)
+                , gap_count(0)
+                , back_count(0)
+            {
+            }
+
+            boost::uint32_t average_size() const
+            {
+                return sample_count ? (boost::uint32_t)(bytes / sample_count) : 0;
+            }
+
+            // bits per second over [first_time, last_time]
+            boost::uint32_t bitrate() const
+            {
+                return last_time != boost::uint64_t(-1) && last_time > first_time 
+                    ? (boost::uint32_t)((bytes - first_bytes) * 8000 / (last_time - first_time)) : 0;
+            }
+
+            // ms between sync samples
+            boost::uint32_t average_sync_interval() const
+            {
+                return sync_interval_count ? (boost::uint32_t)(sync_interval / sync_interval_count) : 0;
+            }
+
+            static boost::uint32_t const GAP_MIN = 1000; // ms, larger delta between samples is a gap
+
+            boost::uint64_t sample_count;
+            boost::uint64_t bytes;
+            boost::uint64_t sync_count;
+            boost::uint64_t first_time; // ms, since last seek, -1 after seek
+            boost::uint64_t first_bytes; // bytes before first_time
+            boost::uint64_t last_time; // ms, -1 after seek
+            boost::uint64_t last_sync_time; // ms
+            boost::uint64_t sync_interval; // ms, sum of intervals
+            boost::uint32_t sync_interval_count;
+            boost::uint32_t max_sync_interval; // ms
+            boost::uint32_t max_delta; // ms between successive samples
+            boost::uint32_t gap_count; // delta over GAP_MIN
+            boost::uint32_t back_count; // time goes backward
+        };
+
+        // POD part of StreamStatus, what monitoring threads see
+        struct StatusSnapshot
+        {
+            boost::uint64_t byte_beg;
+            boost::uint64_t byte_end;
+            boost::uint64_t byte_pos;
+            boost::uint64_t byte_buf;
+            boost::uint64_t time_beg;
+            boost::uint64_t time_end;
+            boost::uint64_t time_pos;
+            boost::uint64_t time_buf;
+        };
+
         class DemuxStatistic
             : public just::avbase::StreamStatistic
         {
+        public:
+            enum OpenPhaseEnum
+            {
+                phase_media,    // open media, get url and info
+                phase_probe,    // detect format from first bytes
+                phase_header,   // parse container header, PAT/PMT, moov, EBML
+                phase_stream,   // discover stream config
+                phase_count
+            };
+
+            struct OpenPhaseStat
+            {
+                OpenPhaseStat()
+                    : beg(0)
+                    , elapse(0)
+                    , wait(0)
+                    , wait_count(0)
+                    , bytes(0)
+                {
+                }
+
+                boost::uint32_t beg; // ms since open begin
+                boost::uint32_t elapse; // ms
+                boost::uint32_t wait; // ms waiting on data
+                boost::uint32_t wait_count;
+                boost::uint64_t bytes; // bytes arrived in this phase
+            };
+
+        public:
+            OpenPhaseStat const & open_phase(
+                OpenPhaseEnum phase) const
+            {
+                return open_phases_[phase];
+            }
+
+            void latency_stat(
+                LatencyStat & stat) const;
+
+            // copy of last published, safe from any thread, at most MAX_TRACKS
+            void track_stat(
+                std::vector<TrackStat> & stats) const;
+
+            static size_t const MAX_TRACKS = 16;
+
+            // ranges of last status published by demux thread, safe from any thread
+            // play position follows samples, the rest follows buffer events
+            bool status_snapshot(
+                StreamStatus & status) const;
+
         protected:
             DemuxStatistic(
                 DemuxerBase & demuxer);
 
+        protected:
+            // ends current phase, phase_media restarts all
+            void open_phase_beg(
+                OpenPhaseEnum phase, 
+                boost::uint64_t bytes);
+
+            void open_phase_end(
+                boost::uint64_t bytes);
+
+            void open_wait_beg();
+
+            void open_wait_end();
+
+            // split stream discovery of inner demuxer out of our header phase
+            void open_phase_merge(
+                DemuxStatistic const & inner);
+
+        protected:
+            // us, monotonic clock
+            static boost::uint64_t latency_now();
+
+            // start a seek, segment_switch or block interval, kept until next sample
+            void latency_mark(
+                LatencyStat::TypeEnum type);
+
+            // end of one get_sample call started at beg, closes marked intervals on success
+            void latency_end(
+                boost::uint64_t beg, 
+                boost::system::error_code const & ec);
+
+        protected:
+            // size tracks at open, so samples don't grow them
+            void track_open(
+                size_t count);
+
+            // count one sample out of demuxer, sample.time must be adjusted
+            void track_sample(
+                Sample const & sample)
+            {
+                if (sample.itrack >= tracks_.size())
+                    tracks_.resize(sample.itrack + 1); // track unknown at open
+                TrackStat & stat = tracks_[sample.itrack];
+                if (stat.sample_count == 0) {
+                    stat.first_time = sample.time;
+                    stat.last_time = sample.time;
+                } else if (stat.first_time == boost::uint64_t(-1)) {
+                    stat.first_time = sample.time;
+                    stat.first_bytes = stat.bytes;
+                }
+                ++stat.sample_count;
+                stat.bytes += sample.size;
+                if (stat.last_time != boost::uint64_t(-1)) {
+                    track_delta(stat, sample.time);
+                }
+                stat.last_time = sample.time;
+                play_time_.store(sample.time, boost::memory_order_relaxed);
+                if (sample.flags & sample.f_sync) {
+                    track_sync(stat, sample.time);
+                }
+                track_publish(sample.itrack);
+            }
+
+            // positions jump, don't count next delta as gap
+            void track_seek();
+
+        private:
+            static void track_delta(
+                TrackStat & stat, 
+                boost::uint64_t time);
+
+            static void track_sync(
+                TrackStat & stat, 
+                boost::uint64_t time);
+
+            void track_publish(
+                size_t itrack);
+
         private:
             virtual void update_stat(
                 boost::system::error_code & ec);
 
         private:
             DemuxerBase & demuxer_;
+            OpenPhaseStat open_phases_[phase_count];
+            size_t open_phase_; // current, phase_count if none
+            boost::uint64_t open_bytes_; // bytes at phase begin
+            boost::uint32_t open_wait_; // wait begin, -1 if not waiting
+            framework::timer::TimeCounter open_clock_;
+            LatencyHistogram latencies_[LatencyStat::type_count];
+            boost::uint64_t latency_begs_[LatencyStat::type_count]; // 0 if not marked
+            std::vector<TrackStat> tracks_; // demux thread only
+            SeqLock<TrackStat> track_snapshots_[MAX_TRACKS]; // published copies for stat readers
+            boost::atomic<size_t> track_count_; // published tracks
+            SeqLock<StatusSnapshot> status_snapshot_;
+            boost::atomic<boost::uint64_t> play_time_; // ms, last sample out
         };
 
     } // namespace demux
@@ -2,6 +2,7 @@
 
 #include "just/demux/Common.h"
 #include "just/demux/base/Demuxer.h"
+#include "just/demux/base/BufferGovernor.h"
 
 #include <framework/logger/Logger.h>
 #include <framework/logger/StreamRecord.h>
@@ -21,11 +22,28 @@ namespace just
             : DemuxerBase(io_svc)
             , DemuxStatistic((DemuxerBase &)*this)
             , timestamp_(&default_timestamp_)
+            , strand_(new boost::asio::io_service::strand(io_svc))
+            , governor_(NULL)
+            , buffer_lease_(0)
+            , granted_buffer_(0)
+            , buffer_priority_(1)
+            , async_sample_(NULL)
         {
+            config_.register_module("Buffer")
+                << CONFIG_PARAM_NAME_RDWR("priority", buffer_priority_);
         }
 
         Demuxer::~Demuxer()
         {
+            release_buffer();
+            delete strand_;
+        }
+
+        void Demuxer::set_worker(
+            boost::asio::io_service & io_svc)
+        {
+            delete strand_;
+            strand_ = new boost::asio::io_service::strand(io_svc);
         }
 
         struct SyncResponse
@@ -112,6 +130,36 @@ namespace just
             return false;
         }
 
+        bool Demuxer::peek_stream_status(
+            StreamStatus & info, 
+            boost::system::error_code & ec) const
+        {
+            if (DemuxStatistic::status_snapshot(info)) {
+                ec.clear();
+            } else {
+                ec = boost::asio::error::would_block;
+            }
+            return !ec;
+        }
+
+        bool Demuxer::get_latency_stat(
+            LatencyStat & stat, 
+            boost::system::error_code & ec) const
+        {
+            DemuxStatistic::latency_stat(stat);
+            ec.clear();
+            return true;
+        }
+
+        bool Demuxer::get_track_stat(
+            std::vector<TrackStat> & stats, 
+            boost::system::error_code & ec) const
+        {
+            DemuxStatistic::track_stat(stats);
+            ec.clear();
+            return true;
+        }
+
         boost::system::error_code Demuxer::reset(
             boost::system::error_code & ec)
         {
@@ -154,11 +202,89 @@ namespace just
             return false;
         }
 
+        void Demuxer::async_get_sample(
+            Sample & sample, 
+            sample_response_type const & resp)
+        {
+            strand_->post(boost::bind(&Demuxer::start_async_get_sample, this, boost::ref(sample), resp));
+        }
+
+        void Demuxer::start_async_get_sample(
+            Sample & sample, 
+            sample_response_type const & resp)
+        {
+            if (!async_resp_.empty()) {
+                get_io_service().post(boost::bind(resp, boost::asio::error::in_progress));
+                return;
+            }
+            async_sample_ = &sample;
+            async_resp_ = resp;
+            handle_async_get_sample(boost::system::error_code());
+        }
+
+        void Demuxer::async_prepare_data(
+            sample_response_type const & resp)
+        {
+            get_io_service().post(boost::bind(resp, boost::asio::error::would_block));
+        }
+
+        void Demuxer::handle_async_get_sample(
+            boost::system::error_code const & ecc)
+        {
+            boost::system::error_code ec;
+            get_sample(*async_sample_, ec);
+            if (ec == boost::asio::error::would_block) {
+                if (!ecc) {
+                    async_prepare_data(
+                        strand_->wrap(boost::bind(&Demuxer::handle_async_get_sample, this, _1)));
+                    return;
+                }
+                ec = ecc;
+            }
+            async_sample_ = NULL;
+            sample_response_type resp;
+            resp.swap(async_resp_);
+            resp(ec);
+        }
+
+        bool Demuxer::acquire_buffer(
+            boost::uint32_t capacity, 
+            boost::uint32_t bitrate, 
+            boost::system::error_code & ec)
+        {
+            release_buffer();
+            if (governor_ == NULL) {
+                granted_buffer_ = capacity;
+                ec.clear();
+                return true;
+            }
+            buffer_lease_ = governor_->acquire(buffer_priority_, bitrate, capacity, granted_buffer_, ec);
+            return !ec;
+        }
+
+        void Demuxer::release_buffer()
+        {
+            if (governor_ && buffer_lease_) {
+                governor_->release(buffer_lease_);
+                buffer_lease_ = 0;
+            }
+        }
+
+        void Demuxer::buffer_active(
+            bool active)
+        {
+            if (governor_ && buffer_lease_) {
+                governor_->set_active(buffer_lease_, active);
+            }
+        }
+
         void Demuxer::on_open()
         {
             if (timestamp_ == &default_timestamp_) {
                 timestamp_->begin(*this);
             }
+            boost::system::error_code ec;
+            DemuxStatistic::track_open(get_stream_count(ec));
         }
 
         void Demuxer::on_close()
@@ -7,11 +7,15 @@
 #include "just/demux/base/DemuxStatistic.h"
 #include "just/demux/base/TimestampHelper.h"
 
+#include <boost/asio/strand.hpp>
+
 namespace just
 {
     namespace demux
     {
 
+        class BufferGovernor;
+
         class Demuxer
             : public DemuxerBase
             , public DemuxStatistic
@@ -48,6 +52,18 @@ namespace just
                 DataStat & stat, 
                 boost::system::error_code & ec) const;
 
+            virtual bool peek_stream_status(
+                StreamStatus & info, 
+                boost::system::error_code & ec) const;
+
+            virtual bool get_latency_stat(
+                LatencyStat & stat, 
+                boost::system::error_code & ec) const;
+
+            virtual bool get_track_stat(
+                std::vector<TrackStat> & stats, 
+                boost::system::error_code & ec) const;
+
         public:
             virtual boost::system::error_code reset(
                 boost::system::error_code & ec);
@@ -68,6 +84,50 @@ namespace just
             virtual bool fill_data(
                 boost::system::error_code & ec);
 
+            // retry get_sample each time async_prepare_data completes
+            virtual void async_get_sample(
+                Sample & sample, 
+                sample_response_type const & resp);
+
+        public:
+            void set_governor(
+                BufferGovernor * governor)
+            {
+                governor_ = governor;
+            }
+
+            // run internal handlers on a worker io_service instead of the daemon one, before open
+            void set_worker(
+                boost::asio::io_service & io_svc);
+
+        protected:
+            // complete when more data arrives in buffer
+            virtual void async_prepare_data(
+                sample_response_type const & resp);
+
+        protected:
+            // wrap internal completion handlers, so one demuxer never runs on two threads
+            boost::asio::io_service::strand & strand()
+            {
+                return *strand_;
+            }
+
+            // capacity of data buffer, limited by governor if any
+            bool acquire_buffer(
+                boost::uint32_t capacity, 
+                boost::uint32_t bitrate, 
+                boost::system::error_code & ec);
+
+            boost::uint32_t granted_buffer() const
+            {
+                return granted_buffer_;
+            }
+
+            void release_buffer();
+
+            void buffer_active(
+                bool active);
+
         protected:
             void on_open();
 
@@ -100,9 +160,29 @@ namespace just
                 return default_timestamp_;
             }
 
+        private:
+            // wrappers forward async_prepare_data to the demuxer they read from
+            friend class CustomDemuxer;
+            friend class SharedSource;
+
+            // in strand, async_sample_ and async_resp_ are only touched there
+            void start_async_get_sample(
+                Sample & sample, 
+                sample_response_type const & resp);
+
+            void handle_async_get_sample(
+                boost::system::error_code const & ecc);
+
         private:
             TimestampHelper * timestamp_;
             TimestampHelper default_timestamp_;
+            boost::asio::io_service::strand * strand_;
+            BufferGovernor * governor_;
+            size_t buffer_lease_;
+            boost::uint32_t granted_buffer_;
+            boost::uint32_t buffer_priority_;
+            Sample * async_sample_;
+            sample_response_type async_resp_;
         };
 
     } // namespace demux
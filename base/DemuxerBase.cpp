@@ -5,6 +5,8 @@
 
 #include <util/daemon/Daemon.h>
 
+#include <boost/bind.hpp>
+
 namespace just
 {
     namespace demux
@@ -21,5 +23,56 @@ namespace just
         {
         }
 
+        size_t DemuxerBase::get_samples(
+            Sample * samples, 
+            size_t max_count, 
+            size_t max_bytes, 
+            boost::system::error_code & ec)
+        {
+            size_t count = 0;
+            size_t bytes = 0;
+            ec.clear();
+            while (count < max_count && bytes < max_bytes) {
+                if (get_sample(samples[count], ec))
+                    break;
+                bytes += samples[count].size;
+                ++count;
+            }
+            return count;
+        }
+
+        void DemuxerBase::async_get_sample(
+            Sample & sample, 
+            sample_response_type const & resp)
+        {
+            boost::system::error_code ec;
+            get_sample(sample, ec);
+            io_svc_.post(boost::bind(resp, ec));
+        }
+
+        bool DemuxerBase::peek_stream_status(
+            StreamStatus & info, 
+            boost::system::error_code & ec) const
+        {
+            ec = framework::system::logic_error::not_supported;
+            return false;
+        }
+
+        bool DemuxerBase::get_latency_stat(
+            LatencyStat & stat, 
+            boost::system::error_code & ec) const
+        {
+            ec = framework::system::logic_error::not_supported;
+            return false;
+        }
+
+        bool DemuxerBase::get_track_stat(
+            std::vector<TrackStat> & stats, 
+            boost::system::error_code & ec) const
+        {
+            ec = framework::system::logic_error::not_supported;
+            return false;
+        }
+
     } // namespace demux
 } // namespace just
@@ -14,6 +14,9 @@ namespace just
     namespace demux
     {
 
+        struct LatencyStat;
+        struct TrackStat;
+
         class DemuxerBase
         {
         public:
@@ -21,6 +24,10 @@ namespace just
                 boost::system::error_code const &)
             > open_response_type;
 
+            typedef boost::function<void (
+                boost::system::error_code const &)
+            > sample_response_type;
+
         public:
             DemuxerBase(
                 boost::asio::io_service & io_svc);
@@ -85,6 +92,21 @@ namespace just
                 Sample & sample, 
                 boost::system::error_code & ec) = 0;
 
+            // fill caller owned samples in one pass, stop at max_count, max_bytes or first error
+            // return count filled, ec is why the pass stopped: clear on max_count or max_bytes,
+            // else error of the sample not filled, filled samples are good even if ec is set
+            // data of filled samples is valid until next get_samples call with same array
+            virtual size_t get_samples(
+                Sample * samples, 
+                size_t max_count, 
+                size_t max_bytes, 
+                boost::system::error_code & ec);
+
+            // complete when a sample is ready or on error, sample must live until then
+            virtual void async_get_sample(
+                Sample & sample, 
+                sample_response_type const & resp);
+
             virtual bool get_stream_status(
                 StreamStatus & info, 
                 boost::system::error_code & ec) = 0;
@@ -93,6 +115,21 @@ namespace just
                 DataStat & stat, 
                 boost::system::error_code & ec) const = 0;
 
+            // snapshot published by demux thread, never touches demuxer, callable from any thread
+            virtual bool peek_stream_status(
+                StreamStatus & info, 
+                boost::system::error_code & ec) const;
+
+            // histograms of get_sample, seek, block and segment switch latencies
+            virtual bool get_latency_stat(
+                LatencyStat & stat, 
+                boost::system::error_code & ec) const;
+
+            // sample counters indexed by itrack
+            virtual bool get_track_stat(
+                std::vector<TrackStat> & stats, 
+                boost::system::error_code & ec) const;
+
         public:
             boost::asio::io_service & get_io_service() const
             {
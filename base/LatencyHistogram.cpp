@@ -0,0 +1,105 @@
+// LatencyHistogram.cpp
+
+#include "just/demux/Common.h"
+#include "just/demux/base/LatencyHistogram.h"
+
+namespace just
+{
+    namespace demux
+    {
+
+        LatencySnapshot::LatencySnapshot()
+            : count(0)
+            , sum(0)
+            , max(0)
+        {
+            memset(counts, 0, sizeof(counts));
+        }
+
+        void LatencySnapshot::merge(
+            LatencySnapshot const & r)
+        {
+            for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+                counts[i] += r.counts[i];
+            }
+            count += r.count;
+            sum += r.sum;
+            if (r.max > max)
+                max = r.max;
+        }
+
+        boost::uint64_t LatencySnapshot::percentile(
+            double p) const
+        {
+            if (count == 0)
+                return 0;
+            boost::uint64_t rank = (boost::uint64_t)(count * p / 100);
+            if (rank >= count)
+                rank = count - 1;
+            boost::uint64_t n = 0;
+            for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+                n += counts[i];
+                if (n > rank)
+                    return bucket_floor(i);
+            }
+            return max;
+        }
+
+        size_t LatencySnapshot::bucket(
+            boost::uint64_t value)
+        {
+            if (value < (1 << SUB_BITS))
+                return (size_t)value;
+            size_t msb = 0;
+            for (size_t shift = 32; shift; shift >>= 1) {
+                if (value >> (msb + shift))
+                    msb += shift;
+            }
+            size_t sub = (size_t)(value >> (msb - SUB_BITS)) & ((1 << SUB_BITS) - 1);
+            size_t index = ((msb - SUB_BITS + 1) << SUB_BITS) + sub;
+            return index < BUCKET_COUNT ? index : BUCKET_COUNT - 1;
+        }
+
+        boost::uint64_t LatencySnapshot::bucket_floor(
+            size_t index)
+        {
+            if (index < (1 << SUB_BITS))
+                return index;
+            size_t msb = (index >> SUB_BITS) - 1 + SUB_BITS;
+            boost::uint64_t sub = index & ((1 << SUB_BITS) - 1);
+            return ((1 << SUB_BITS) | sub) << (msb - SUB_BITS);
+        }
+
+        LatencyHistogram::LatencyHistogram()
+            : sum_(0)
+            , max_(0)
+        {
+            for (size_t i = 0; i < LatencySnapshot::BUCKET_COUNT; ++i) {
+                counts_[i].store(0, boost::memory_order_relaxed);
+            }
+        }
+
+        void LatencyHistogram::record(
+            boost::uint64_t value)
+        {
+            boost::atomic<boost::uint32_t> & count = counts_[LatencySnapshot::bucket(value)];
+            count.store(count.load(boost::memory_order_relaxed) + 1, boost::memory_order_relaxed);
+            sum_.store(sum_.load(boost::memory_order_relaxed) + value, boost::memory_order_relaxed);
+            if (value > max_.load(boost::memory_order_relaxed))
+                max_.store(value, boost::memory_order_relaxed);
+        }
+
+        void LatencyHistogram::snapshot(
+            LatencySnapshot & snapshot) const
+        {
+            snapshot = LatencySnapshot();
+            for (size_t i = 0; i < LatencySnapshot::BUCKET_COUNT; ++i) {
+                snapshot.counts[i] = counts_[i].load(boost::memory_order_relaxed);
+                snapshot.count += snapshot.counts[i];
+            }
+            snapshot.sum = sum_.load(boost::memory_order_relaxed);
+            snapshot.max = max_.load(boost::memory_order_relaxed);
+        }
+
+    } // namespace demux
+} // namespace just
@@ -0,0 +1,90 @@
+// LatencyHistogram.h
+
+#ifndef _JUST_DEMUX_BASE_LATENCY_HISTOGRAM_H_
+#define _JUST_DEMUX_BASE_LATENCY_HISTOGRAM_H_
+
+#include <boost/atomic.hpp>
+
+namespace just
+{
+    namespace demux
+    {
+
+        // Log-linear buckets of microseconds, 4 sub buckets per power of 2, up to about 2 hours
+        struct LatencySnapshot
+        {
+            static size_t const SUB_BITS = 2;
+            static size_t const BUCKET_COUNT = 128;
+
+            LatencySnapshot();
+
+            void merge(
+                LatencySnapshot const & r);
+
+            // lower bound of the bucket containing p (0 - 100) percent of samples
+            boost::uint64_t percentile(
+                double p) const;
+
+            boost::uint64_t mean() const
+            {
+                return count ? sum / count : 0;
+            }
+
+            static size_t bucket(
+                boost::uint64_t value);
+
+            static boost::uint64_t bucket_floor(
+                size_t index);
+
+            boost::uint64_t counts[BUCKET_COUNT];
+            boost::uint64_t count;
+            boost::uint64_t sum; // us
+            boost::uint64_t max; // us
+        };
+
+        // Recorded on hot path by the demuxer thread, read any time by others
+        // one writer at a time, relaxed atomics only keep readers from tearing
+        class LatencyHistogram
+        {
+        public:
+            LatencyHistogram();
+
+        public:
+            void record(
+                boost::uint64_t value);
+
+            void snapshot(
+                LatencySnapshot & snapshot) const;
+
+        private:
+            boost::atomic<boost::uint32_t> counts_[LatencySnapshot::BUCKET_COUNT];
+            boost::atomic<boost::uint64_t> sum_;
+            boost::atomic<boost::uint64_t> max_;
+        };
+
+        struct LatencyStat
+        {
+            enum TypeEnum
+            {
+                get_sample,     // one get_sample (or get_samples batch) call
+                seek,           // seek call to first sample after it
+                block,          // first would_block to next sample
+                segment_switch, // finish segment to next segment demuxer ready
+                type_count
+            };
+
+            void merge(
+                LatencyStat const & r)
+            {
+                for (size_t i = 0; i < type_count; ++i) {
+                    latencies[i].merge(r.latencies[i]);
+                }
+            }
+
+            LatencySnapshot latencies[type_count];
+        };
+
+    } // namespace demux
+} // namespace just
+
+#endif // _JUST_DEMUX_BASE_LATENCY_HISTOGRAM_H_
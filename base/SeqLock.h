@@ -0,0 +1,73 @@
+// SeqLock.h
+
+#ifndef _JUST_DEMUX_BASE_SEQ_LOCK_H_
+#define _JUST_DEMUX_BASE_SEQ_LOCK_H_
+
+#include <boost/atomic.hpp>
+
+#include <string.h>
+
+namespace just
+{
+    namespace demux
+    {
+
+        // Value published by one writer thread, copied out by any thread without lock
+        // readers retry while the writer is in, writer never waits
+        // T must be POD, it is copied word by word through atomics
+        template <typename T>
+        class SeqLock
+        {
+        public:
+            SeqLock()
+                : seq_(0)
+            {
+                for (size_t i = 0; i < WORDS; ++i)
+                    words_[i].store(0, boost::memory_order_relaxed);
+            }
+
+        public:
+            // writer side
+            void store(
+                T const & t)
+            {
+                boost::uint32_t seq = seq_.load(boost::memory_order_relaxed);
+                seq_.store(seq + 1, boost::memory_order_relaxed);
+                boost::atomic_thread_fence(boost::memory_order_release);
+                boost::uint64_t words[WORDS] = {0};
+                memcpy(words, &t, sizeof(T));
+                for (size_t i = 0; i < WORDS; ++i)
+                    words_[i].store(words[i], boost::memory_order_relaxed);
+                seq_.store(seq + 2, boost::memory_order_release);
+            }
+
+            // reader side, false if never stored
+            bool load(
+                T & t) const
+            {
+                while (true) {
+                    boost::uint32_t seq = seq_.load(boost::memory_order_acquire);
+                    if (seq & 1)
+                        continue;
+                    boost::uint64_t words[WORDS];
+                    for (size_t i = 0; i < WORDS; ++i)
+                        words[i] = words_[i].load(boost::memory_order_relaxed);
+                    boost::atomic_thread_fence(boost::memory_order_acquire);
+                    if (seq_.load(boost::memory_order_relaxed) == seq) {
+                        memcpy(&t, words, sizeof(T));
+                        return seq != 0;
+                    }
+                }
+            }
+
+        private:
+            static size_t const WORDS = (sizeof(T) + 7) / 8;
+
+            boost::atomic<boost::uint32_t> seq_;
+            boost::atomic<boost::uint64_t> words_[WORDS];
+        };
+
+    } // namespace demux
+} // namespace just
+
+#endif // _JUST_DEMUX_BASE_SEQ_LOCK_H_
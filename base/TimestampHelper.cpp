@@ -9,6 +9,50 @@ namespace just
     namespace demux
     {
 
+        FastScaleTransform::FastScaleTransform(
+            boost::uint64_t scale_in, 
+            boost::uint64_t scale_out)
+            : num_(scale_out)
+            , den_(scale_in)
+            , mul_(1)
+            , shift_(0)
+            , step_max_(0)
+            , last_(0)
+            , rem_(0)
+            , out_(0)
+        {
+            boost::uint64_t a = num_;
+            boost::uint64_t b = den_;
+            while (b) {
+                boost::uint64_t t = a % b;
+                a = b;
+                b = t;
+            }
+            num_ /= a;
+            den_ /= a;
+            boost::uint64_t const acc_max = boost::uint64_t(1) << 31;
+            if (den_ >= acc_max || num_ >= acc_max)
+                return;
+            // with acc < 2^31 and den_ <= 2^L: mul_ <= 2^33, acc * mul_ fits 64 bits
+            // and acc * (mul_ * den_ - 2^shift_) < 2^shift_, so quotient is exact
+            boost::uint32_t l = 0;
+            while ((boost::uint64_t(1) << l) < den_)
+                ++l;
+            shift_ = 32 + l;
+            mul_ = ((boost::uint64_t(1) << shift_) + den_ - 1) / den_;
+            step_max_ = (acc_max - den_) / num_;
+        }
+
+        boost::uint64_t FastScaleTransform::transfer_exact(
+            boost::uint64_t v) const
+        {
+            boost::uint64_t r = (v % den_) * num_;
+            out_ = (v / den_) * num_ + r / den_;
+            rem_ = r % den_;
+            last_ = v;
+            return out_;
+        }
+
         TimestampHelper::TimestampHelper()
             : max_delta_(500)
             , max_delta2_(5000)
@@ -14,6 +14,52 @@ namespace just
 
         class DemuxerBase;
 
+        // Same result as ScaleTransform::transfer, floor(v * scale_out / scale_in)
+        // forward steps of a track are converted with multiply and shift on the remainder
+        // anything else (first value, backward or huge jump) goes exact path
+        class FastScaleTransform
+        {
+        public:
+            FastScaleTransform(
+                boost::uint64_t scale_in, 
+                boost::uint64_t scale_out);
+
+        public:
+            boost::uint64_t transfer(
+                boost::uint64_t v) const
+            {
+                if (v >= last_ && v - last_ < step_max_) {
+                    boost::uint64_t acc = rem_ + (v - last_) * num_;
+                    boost::uint64_t q = (acc * mul_) >> shift_;
+                    rem_ = acc - q * den_;
+                    last_ = v;
+                    out_ += q;
+                    return out_;
+                }
+                return transfer_exact(v);
+            }
+
+            // last result
+            boost::uint64_t get() const
+            {
+                return out_;
+            }
+
+        private:
+            boost::uint64_t transfer_exact(
+                boost::uint64_t v) const;
+
+        private:
+            boost::uint64_t num_; // scale_out / scale_in reduced to num_ / den_
+            boost::uint64_t den_;
+            boost::uint64_t mul_; // ceil(2^shift_ / den_)
+            boost::uint32_t shift_;
+            boost::uint64_t step_max_; // keeps acc below 2^31, 0 for exact only
+            mutable boost::uint64_t last_;
+            mutable boost::uint64_t rem_; // last_ * num_ % den_
+            mutable boost::uint64_t out_;
+        };
+
         class TimestampHelper
         {
         public:
@@ -29,6 +75,7 @@ namespace just
                     return;
                 for (size_t i = 0; i < time_scale.size(); ++i) {
                     time_trans_.push_back(ScaleTransform(time_scale[i], 1000, 0));
+                    fast_trans_.push_back(FastScaleTransform(time_scale[i], 1000));
                     dts_offset_.push_back(time_trans_[i].revert(time_offset_));
                 }
             }
@@ -95,8 +142,8 @@ namespace just
             {
                 assert(sample.itrack < dts_offset_.size());
                 sample.dts += dts_offset_[sample.itrack];
-                boost::uint64_t time = time_trans_[sample.itrack].get();
-                sample.time = time_trans_[sample.itrack].transfer(sample.dts);
+                boost::uint64_t time = fast_trans_[sample.itrack].get();
+                sample.time = fast_trans_[sample.itrack].transfer(sample.dts);
                 if (time + max_delta2_ < sample.time) {
                     sample.flags |= sample.f_discontinuity;
                     if (time + max_delta2_ < sample.time) {
@@ -113,7 +160,7 @@ namespace just
                 boost::uint64_t dts)
             {
                 assert(itrack < dts_offset_.size());
-                boost::uint64_t time = time_trans_[itrack].transfer(dts + dts_offset_[itrack]);
+                boost::uint64_t time = fast_trans_[itrack].transfer(dts + dts_offset_[itrack]);
                 return time;
             }
 
@@ -122,8 +169,8 @@ namespace just
             {
                 assert(sample.itrack < dts_offset_.size());
                 sample.dts += dts_offset_[sample.itrack];
-                boost::uint64_t time = time_trans_[sample.itrack].get();
-                sample.time = time_trans_[sample.itrack].transfer(sample.dts);
+                boost::uint64_t time = fast_trans_[sample.itrack].get();
+                sample.time = fast_trans_[sample.itrack].transfer(sample.dts);
                 if (time + max_delta_ < sample.time) {
                     sample.flags |= sample.f_discontinuity;
                 }
@@ -134,7 +181,7 @@ namespace just
                 boost::uint64_t dts) const
             {
                 assert(itrack < dts_offset_.size());
-                boost::uint64_t time = time_trans_[itrack].transfer(dts + dts_offset_[itrack]);
+                boost::uint64_t time = fast_trans_[itrack].transfer(dts + dts_offset_[itrack]);
                 return time;
             }
 
@@ -162,7 +209,7 @@ namespace just
 
             boost::uint64_t time() const
             {
-                return time_trans_.front().get();
+                return fast_trans_.front().get();
             }
 
             boost::uint64_t reset_time() const
@@ -176,7 +223,8 @@ namespace just
             boost::uint32_t max_delta2_; // 룬
             boost::uint64_t time_offset_; // 
             std::vector<boost::uint64_t> dts_offset_;
-            std::vector<framework::system::ScaleTransform> time_trans_; // dts -> time
+            std::vector<framework::system::ScaleTransform> time_trans_; // time -> dts
+            std::vector<FastScaleTransform> fast_trans_; // dts -> time
         };
 
     } // namespace demux
@@ -0,0 +1,78 @@
+// WorkerPool.cpp
+
+#include "just/demux/Common.h"
+#include "just/demux/base/WorkerPool.h"
+
+#include <framework/logger/Logger.h>
+#include <framework/logger/StreamRecord.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+FRAMEWORK_LOGGER_DECLARE_MODULE_LEVEL("just.demux.WorkerPool", framework::logger::Debug);
+
+namespace just
+{
+    namespace demux
+    {
+
+        WorkerPool::WorkerPool()
+            : work_(NULL)
+        {
+        }
+
+        WorkerPool::~WorkerPool()
+        {
+            stop();
+        }
+
+        bool WorkerPool::start(
+            size_t count, 
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            if (work_) {
+                ec = framework::system::logic_error::item_already_exist;
+                return false;
+            }
+            // keep workers alive when the io_service has nothing to do
+            io_svc_.reset();
+            work_ = new boost::asio::io_service::work(io_svc_);
+            for (size_t i = 0; i < count; ++i) {
+                threads_.push_back(new boost::thread(boost::bind(&WorkerPool::run, this)));
+            }
+            LOG_INFO("[start] workers: " << count);
+            ec.clear();
+            return true;
+        }
+
+        void WorkerPool::stop()
+        {
+            std::vector<boost::thread *> threads;
+            {
+                boost::mutex::scoped_lock lock(mutex_);
+                if (work_ == NULL)
+                    return;
+                delete work_;
+                work_ = NULL;
+                threads.swap(threads_);
+            }
+            // pending handlers still run, demuxers are cancelled before
+            for (size_t i = 0; i < threads.size(); ++i) {
+                threads[i]->join();
+                delete threads[i];
+            }
+            LOG_INFO("[stop] workers: " << threads.size());
+        }
+
+        void WorkerPool::run()
+        {
+            boost::system::error_code ec;
+            io_svc_.run(ec);
+            if (ec) {
+                LOG_WARN("[run] ec: " << ec.message());
+            }
+        }
+
+    } // namespace demux
+} // namespace just
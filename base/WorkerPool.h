@@ -0,0 +1,59 @@
+// WorkerPool.h
+
+#ifndef _JUST_DEMUX_BASE_WORKER_POOL_H_
+#define _JUST_DEMUX_BASE_WORKER_POOL_H_
+
+#include <boost/asio/io_service.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace boost
+{
+    class thread;
+}
+
+namespace just
+{
+    namespace demux
+    {
+
+        // Extra threads running a private io_service, daemon io_service stays on its own threads
+        // demuxers moved here by Demuxer::set_worker get their handlers serialized by own strand,
+        // different demuxers run in parallel
+        class WorkerPool
+        {
+        public:
+            WorkerPool();
+
+            ~WorkerPool();
+
+        public:
+            bool start(
+                size_t count, 
+                boost::system::error_code & ec);
+
+            void stop();
+
+            size_t size() const
+            {
+                return threads_.size();
+            }
+
+            boost::asio::io_service & io_svc()
+            {
+                return io_svc_;
+            }
+
+        private:
+            void run();
+
+        private:
+            boost::asio::io_service io_svc_;
+            boost::asio::io_service::work * work_;
+            boost::mutex mutex_;
+            std::vector<boost::thread *> threads_;
+        };
+
+    } // namespace demux
+} // namespace just
+
+#endif // _JUST_DEMUX_BASE_WORKER_POOL_H_
@@ -11,6 +11,9 @@ using namespace just::avformat::error;
 #include <framework/logger/StreamRecord.h>
 
 #include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <deque>
 
 FRAMEWORK_LOGGER_DECLARE_MODULE_LEVEL("just.demux.BasicDemuxer", framework::logger::Debug);
 
@@ -93,6 +96,7 @@ namespace just
                 ec = file_stream_error;
                 return ec;
             }
+            track_seek();
             return ec;
         }
 
@@ -114,6 +118,7 @@ namespace just
                 ec = file_stream_error;
                 return ec;
             }
+            track_seek();
             time = (boost::uint64_t)-1;
             for (size_t i = 0; i < dts.size(); ++i) {
                 boost::uint64_t time2 = timestamp().adjust(i, dts[i]);
@@ -132,6 +137,30 @@ namespace just
             return true;
         }
 
+        size_t BasicDemuxer::get_samples(
+            Sample * samples, 
+            size_t max_count, 
+            size_t max_bytes, 
+            boost::system::error_code & ec)
+        {
+            if (batch_datas_.size() < max_count)
+                batch_datas_.resize(max_count);
+            size_t count = 0;
+            size_t bytes = 0;
+            ec.clear();
+            while (count < max_count && bytes < max_bytes) {
+                Sample & sample = samples[count];
+                if (get_sample(sample, ec))
+                    break;
+                // datas_ is overwritten by next sample
+                batch_datas_[count].swap(datas_);
+                sample.context = &batch_datas_[count];
+                bytes += sample.size;
+                ++count;
+            }
+            return count;
+        }
+
         boost::uint32_t BasicDemuxer::probe(
             boost::uint8_t const * header, 
             size_t hsize)
@@ -164,6 +193,7 @@ namespace just
         void BasicDemuxer::on_open()
         {
             assert(!is_open_);
+            open_phase_end(buffered_bytes());
             Demuxer::on_open();
             if (joint_) {
                 if (timestamp_) {
@@ -179,6 +209,19 @@ namespace just
             is_open_ = true;
         }
 
+        void BasicDemuxer::open_stream_beg()
+        {
+            open_phase_beg(phase_stream, buffered_bytes());
+        }
+
+        boost::uint64_t BasicDemuxer::buffered_bytes()
+        {
+            std::streampos pos = buf_.pubseekoff(0, std::ios::cur, std::ios::in);
+            std::streampos end = buf_.pubseekoff(0, std::ios::end, std::ios::in);
+            buf_.pubseekoff(pos, std::ios::beg, std::ios::in);
+            return (boost::uint64_t)(std::streamoff)end;
+        }
+
         void BasicDemuxer::on_close()
         {
             assert(is_open_);
@@ -289,32 +332,123 @@ namespace just
             return smap;
         }
 
+        struct BasicDemuxerFactory::ProbeCache
+        {
+            typedef std::map<std::string, std::pair<std::string, boost::uint32_t> > map_t;
+
+            static size_t const MAX_SIZE = 1024;
+
+            boost::mutex mutex;
+            map_t map;
+            std::deque<std::string> order; // keys in order of insert, oldest evicted first
+        };
+
+        BasicDemuxerFactory::ProbeCache & BasicDemuxerFactory::probe_cache()
+        {
+            static ProbeCache cache;
+            return cache;
+        }
+
+        bool BasicDemuxerFactory::probe_cached(
+            std::string const & key, 
+            std::string & format, 
+            boost::uint32_t & scope)
+        {
+            ProbeCache & cache(probe_cache());
+            boost::mutex::scoped_lock lock(cache.mutex);
+            ProbeCache::map_t::const_iterator iter = cache.map.find(key);
+            if (iter == cache.map.end())
+                return false;
+            format = iter->second.first;
+            scope = iter->second.second;
+            return true;
+        }
+
+        void BasicDemuxerFactory::clear_probe_cache()
+        {
+            ProbeCache & cache(probe_cache());
+            boost::mutex::scoped_lock lock(cache.mutex);
+            cache.map.clear();
+            cache.order.clear();
+        }
+
+        bool BasicDemuxerFactory::is_support(
+            std::string const & format)
+        {
+            probe_map_t & map(probe_funcs());
+            return map.find(format) != map.end();
+        }
+
         std::string BasicDemuxerFactory::probe(
             std::basic_streambuf<boost::uint8_t> & content,
             boost::system::error_code & ec)
         {
+            boost::uint32_t scope = 0;
+            return probe(content, std::string(), 0, false, scope, ec);
+        }
+
+        std::string BasicDemuxerFactory::probe(
+            std::basic_streambuf<boost::uint8_t> & content,
+            std::string const & key, 
+            size_t window, 
+            bool end, 
+            boost::uint32_t & scope, 
+            boost::system::error_code & ec)
+        {
+            std::string format;
+            if (!key.empty() && probe_cached(key, format, scope)) {
+                ec.clear();
+                return format;
+            }
+
+            if (window == 0) {
+                window = DEFAULT_PROBE_WINDOW;
+            } else if (window > MAX_PROBE_WINDOW) {
+                window = MAX_PROBE_WINDOW;
+            }
+
             probe_map_t & map(probe_funcs());
             probe_map_t::const_iterator iter = map.begin();
             probe_map_t::const_iterator max_iter = map.end();
             boost::uint32_t max_scope = 0;
-            boost::uint8_t hbytes[32];
-            size_t hsize = content.sgetn(hbytes, sizeof(hbytes));
+            std::vector<boost::uint8_t> hbytes(window);
+            size_t hsize = content.sgetn(&hbytes[0], window);
             for (; iter != map.end(); ++iter) {
-                boost::uint32_t scope = iter->second(hbytes, hsize);
+                boost::uint32_t scope = iter->second(&hbytes[0], hsize);
                 if (scope > max_scope) {
                     max_iter = iter;
                     max_scope = scope;
                 }
             }
             content.pubseekpos(0, std::ios::in);
+            scope = max_scope;
+            // a better match may need more bytes, unless this one is certain
+            if (hsize < window && !end && max_scope < BasicDemuxer::SCOPE_MAX) {
+                ec = boost::asio::error::try_again;
+                return "";
+            }
             if (max_iter == map.end()) {
-                if (hsize < 32) {
-                    ec = boost::asio::error::try_again;
-                } else {
-                    ec = error::not_support;
-                }
+                ec = error::not_support;
                 return "";
             }
+            ec.clear();
+            LOG_DEBUG("[probe] format: " << max_iter->first << ", scope: " << max_scope << ", bytes: " << hsize);
+            if (!key.empty() && hsize == window) {
+                // only verdicts on full window are remembered
+                ProbeCache & cache(probe_cache());
+                boost::mutex::scoped_lock lock(cache.mutex);
+                std::pair<ProbeCache::map_t::iterator, bool> ins = 
+                    cache.map.insert(std::make_pair(key, std::make_pair(max_iter->first, max_scope)));
+                if (ins.second) {
+                    cache.order.push_back(key);
+                    if (cache.order.size() > ProbeCache::MAX_SIZE) {
+                        cache.map.erase(cache.order.front());
+                        cache.order.pop_front();
+                    }
+                } else {
+                    ins.first->second = std::make_pair(max_iter->first, max_scope);
+                }
+            }
             return max_iter->first;
         }
 
@@ -52,6 +52,13 @@ namespace just
                 Sample & sample, 
                 boost::system::error_code & ec);
 
+            // each sample keeps its own data blocks, valid until next batch
+            virtual size_t get_samples(
+                Sample * samples, 
+                size_t max_count, 
+                size_t max_bytes, 
+                boost::system::error_code & ec);
+
         public:
             virtual boost::uint64_t get_duration(
                 boost::system::error_code & ec) const = 0;
@@ -91,6 +98,13 @@ namespace just
 
             virtual void joint_end2();
 
+            // carries parse state from one segment to next (joint data or share info),
+            // such segments can't be demuxed apart from previous one
+            virtual bool joint_carry() const
+            {
+                return false;
+            }
+
         public:
             boost::uint64_t get_joint_cur_time(
                 boost::system::error_code & ec) const;
@@ -114,6 +128,9 @@ namespace just
 
             void on_close();
 
+            // header parsed, stream config discovery begins
+            void open_stream_beg();
+
             void begin_sample(
                 Sample & sample)
             {
@@ -137,14 +154,20 @@ namespace just
             {
                 adjust_timestamp(sample);
                 sample.context = &datas_;
+                track_sample(sample);
             }
 
-        protected:
+        public:
+            // best probe score, also used by DemuxModule to weigh probe results
             static boost::uint32_t const SCOPE_MAX = 100;
 
+        private:
+            boost::uint64_t buffered_bytes();
+
         private:
             streambuffer_t & buf_;
             std::vector<just::data::DataBlock> datas_;
+            std::vector<std::vector<just::data::DataBlock> > batch_datas_;
             bool is_open_;
             JointContext * joint_;
             TimestampHelper * timestamp_;
@@ -171,10 +194,38 @@ namespace just
                 size_t hsize);
 
         public:
+            // default window, try_again on short content as before
             static std::string probe(
                 std::basic_streambuf<boost::uint8_t> & content,
                 boost::system::error_code & ec);
 
+            // window: max bytes examined, 0 for default
+            // key: media url or content type, verdict is remembered by key if not empty
+            // end: no more content will come, otherwise try_again until window is full
+            static std::string probe(
+                std::basic_streambuf<boost::uint8_t> & content,
+                std::string const & key, 
+                size_t window, 
+                bool end, 
+                boost::uint32_t & scope, 
+                boost::system::error_code & ec);
+
+            // verdict of previous probe on same key
+            static bool probe_cached(
+                std::string const & key, 
+                std::string & format, 
+                boost::uint32_t & scope);
+
+            static void clear_probe_cache();
+
+            // has native demuxer
+            static bool is_support(
+                std::string const & format);
+
+        public:
+            static size_t const DEFAULT_PROBE_WINDOW = 2048;
+            static size_t const MAX_PROBE_WINDOW = 1024 * 1024;
+
         public:
             template <typename Demuxer>
             static void register_class(
@@ -187,6 +238,9 @@ namespace just
         private:
             typedef std::map<std::string, probe_func_t> probe_map_t;
             static probe_map_t & probe_funcs();
+
+            struct ProbeCache;
+            static ProbeCache & probe_cache();
         };
 
     } // namespace demux
@@ -30,6 +30,8 @@ namespace just
             , open_step_((boost::uint64_t)-1)
             , parse_offset_(0)
             , header_offset_(0)
+            , index_(buf)
+            , lazy_index_(false)
             , stream_list_(new StreamList)
         {
         }
@@ -65,6 +67,8 @@ namespace just
                 streams_.clear();
             }
             file_.close();
+            index_.clear();
+            lazy_index_ = false;
             return ec;
         }
 
@@ -82,49 +86,110 @@ namespace just
                 return false;
             }
 
-            AviBoxContext ctx;
-            archive_.context(&ctx);
-            archive_.seekg(parse_offset_, std::ios::beg);
-            assert(archive_);
-
-            if (parse_offset_ == 0) {
-                AviBoxHeader h;
-                if (archive_ >> h)
-                    parse_offset_ = archive_.tellg();
-            }
-
+            if (open_step_ == 0) {
+                AviBoxContext ctx;
+                archive_.context(&ctx);
+                archive_.seekg(parse_offset_, std::ios::beg);
+                assert(archive_);
 
-            if (box_.get() == NULL)
-                box_.reset(new AviBox);
-            while (archive_ >> *box_) {
-                AviBox * box = box_.release();
-                parse_offset_ = archive_.tellg();
-                if (file_.open(box, ec)) {
-                    open_step_ = 1;
-                    break;
-                }
-                if (ec) {
-                    break;
+                if (parse_offset_ == 0) {
+                    AviBoxHeader h;
+                    if (archive_ >> h)
+                        parse_offset_ = archive_.tellg();
                 }
-                if (box->id() == AviBoxType::movi) {
-                    std::streamoff end = archive_.tellg() + (std::streamoff)box->data_size();
-                    header_offset_ = archive_.tellg();
-                    archive_.rdbuf()->pubseekoff(end, std::ios::beg, std::ios::in | std::ios::out);
-                    if (!archive_)
+
+                if (box_.get() == NULL)
+                    box_.reset(new AviBox);
+                while (archive_) {
+                    boost::uint64_t box_offset = archive_.tellg();
+                    AviIndex::ChunkHeader chunk;
+                    bool peeked = index_.peek(box_offset, chunk);
+                    if (peeked && chunk.id == AviIndex::ID_IDX1 && index_.has_header()) {
+                        // leave idx1 in file, it is paged in on demand
+                        index_.idx1(box_offset + 8, chunk.size);
+                        lazy_index_ = true;
+                        open_step_ = 1;
+                        break;
+                    }
+                    if (!(archive_ >> *box_))
                         break;
+                    AviBox * box = box_.release();
+                    parse_offset_ = archive_.tellg();
+                    if (peeked && chunk.id == AviIndex::ID_LIST && chunk.type == AviIndex::ID_HDRL) {
+                        boost::system::error_code ec1;
+                        if (!index_.parse_header_list(box_offset + 12, chunk.size - 4, ec1)) {
+                            LOG_WARN("[is_open] failed to scan header list: " << ec1.message());
+                        }
+                    }
+                    if (file_.open(box, ec)) {
+                        open_step_ = 1;
+                        break;
+                    }
+                    if (ec) {
+                        break;
+                    }
+                    if (box->id() == AviBoxType::movi) {
+                        std::streamoff end = archive_.tellg() + (std::streamoff)box->data_size();
+                        header_offset_ = archive_.tellg();
+                        index_.movi(header_offset_ - 4);
+                        if (index_.has_super_index()) {
+                            // OpenDML, standard indexes are located by super index, skip idx1
+                            lazy_index_ = true;
+                            open_step_ = 1;
+                            break;
+                        }
+                        archive_.rdbuf()->pubseekoff(end, std::ios::beg, std::ios::in | std::ios::out);
+                        if (!archive_)
+                            break;
+                        parse_offset_ = end;
+                    }
+                    box_.reset(new AviBox);
+                }
+
+                if (open_step_ == 0) {
+                    if (!archive_) {
+                        if (archive_.failed()) {
+                            box_.reset();
+                            ec = bad_media_format;
+                        } else {
+                            ec = file_stream_error;
+                        }
+                        archive_.clear();
+                    }
+                    return !ec;
                 }
-                box_.reset(new AviBox);
             }
 
             if (open_step_ == 1) {
+                if (file_.header_list() == NULL) {
+                    ec = bad_media_format;
+                    return false;
+                }
                 std::vector<just::avformat::AviStream *> & streams(file_.header_list()->streams());
-                for (std::vector<just::avformat::AviStream *>::iterator iter = streams.begin(); iter != streams.end(); ++iter) {
-                    just::avformat::AviStream & stream(**iter);
+                if (lazy_index_) {
+                    // first index chunk of every stream, may wait for data
+                    for (size_t i = 0; i < streams.size(); ++i) {
+                        if (streams[i]->type() == AviStreamType::auds
+                            || streams[i]->type() == AviStreamType::vids) {
+                                index_.cursor(i);
+                        }
+                    }
+                    if (!index_.rewind(ec)) {
+                        return false;
+                    }
+                }
+                for (size_t i = 0; i < streams.size(); ++i) {
+                    just::avformat::AviStream & stream(*streams[i]);
                     if (stream.type() != AviStreamType::auds
                         && stream.type() != AviStreamType::vids) {
                             continue;
                     }
-                    just::demux::AviStream * stream2 = new just::demux::AviStream(streams_.size(), stream, timestamp());
+                    AviIndexCursor * cursor = lazy_index_ ? index_.cursor(i) : NULL;
+                    if (lazy_index_ && cursor == NULL) {
+                        LOG_WARN("[is_open] no index for stream " << i);
+                        continue;
+                    }
+                    just::demux::AviStream * stream2 = new just::demux::AviStream(streams_.size(), stream, timestamp(), cursor);
                     if (stream2->parse(ec)) {
                         streams_.push_back(stream2);
                         stream_list_->push(stream2);
@@ -139,16 +204,6 @@ namespace just
                     open_step_ = 2;
                     on_open();
                 }
-            } else {
-                if (!archive_) {
-                    if (archive_.failed()) {
-                        box_.reset();
-                        ec = bad_media_format;
-                    } else {
-                        ec = file_stream_error;
-                    }
-                    archive_.clear();
-                }
             }
 
             return !ec;
@@ -219,6 +274,11 @@ namespace just
 
             AviStream & stream = *stream_list_->first();
             stream.get_sample(sample);
+            // next index chunk not ready, retry without consuming sample,
+            // done before checking sample data, as fetching index moves download position
+            if (!stream.prepare_next(ec)) {
+                return ec;
+            }
             archive_.seekg(sample.time + sample.size, std::ios_base::beg);
             if (!archive_) {
                 archive_.clear();
@@ -272,6 +332,9 @@ namespace just
                 if (streams_[i]->seek(time, ec)) {
                     dts[i] = (boost::uint64_t)time;
                     stream_time_list.push(streams_[i]);
+                } else if (ec == file_stream_error) {
+                    // index not downloaded yet, let caller retry
+                    return 0;
                 }
             }
             if (stream_time_list.empty()) {
@@ -292,8 +355,11 @@ namespace just
                 if (stream->seek(time, ec)) {
                     dts[stream->index] = time;
                     stream_offset_list.push(stream);
+                } else if (ec == file_stream_error) {
+                    return 0;
                 }
             }
+            ec.clear();
 
             boost::uint64_t seek_offset = stream_offset_list.first()->offset();
 
@@ -312,7 +378,7 @@ namespace just
             if (hsize < 12)
                 return 0;
             if (memcmp(header, "RIFF", 4) == 0
-                && memcmp(header + 8, "AVI ", 4)) {
+                && memcmp(header + 8, "AVI ", 4) == 0) {
                     return SCOPE_MAX;
             }
             return 0;
@@ -5,6 +5,7 @@
 
 #include "just/demux/basic/BasicDemuxer.h"
 #include "just/demux/basic/avi/AviStream.h"
+#include "just/demux/basic/avi/AviIndex.h"
 
 #include <just/avformat/avi/lib/AviFile.h>
 #include <just/avformat/avi/box/AviBoxArchive.h>
@@ -90,6 +91,8 @@ namespace just
 
             just::avformat::AviFile file_;
             std::auto_ptr<just::avformat::AviBox> box_;
+            AviIndex index_;
+            bool lazy_index_; // index_ is used instead of index loaded by just::avformat
             std::vector<AviStream *> streams_;
             StreamList * stream_list_;
             //const_pointer copy_from_;
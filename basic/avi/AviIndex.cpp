@@ -0,0 +1,547 @@
+// AviIndex.cpp
+
+#include "just/demux/Common.h"
+#include "just/demux/basic/avi/AviIndex.h"
+
+using namespace just::avformat::error;
+
+#include <framework/logger/Logger.h>
+#include <framework/logger/StreamRecord.h>
+
+FRAMEWORK_LOGGER_DECLARE_MODULE_LEVEL("just.demux.AviIndex", framework::logger::Warn)
+
+namespace just
+{
+    namespace demux
+    {
+
+        namespace detail
+        {
+
+            inline boost::uint16_t avi_le16(
+                boost::uint8_t const * p)
+            {
+                return (boost::uint16_t)(p[0] | (p[1] << 8));
+            }
+
+            inline boost::uint32_t avi_le32(
+                boost::uint8_t const * p)
+            {
+                return (boost::uint32_t)p[0]
+                    | ((boost::uint32_t)p[1] << 8)
+                    | ((boost::uint32_t)p[2] << 16)
+                    | ((boost::uint32_t)p[3] << 24);
+            }
+
+            inline boost::uint64_t avi_le64(
+                boost::uint8_t const * p)
+            {
+                return (boost::uint64_t)avi_le32(p) | ((boost::uint64_t)avi_le32(p + 4) << 32);
+            }
+
+        } // namespace detail
+
+        using detail::avi_le16;
+        using detail::avi_le32;
+        using detail::avi_le64;
+
+        static boost::uint8_t const AVI_INDEX_OF_INDEXES = 0x00;
+        static boost::uint8_t const AVI_INDEX_OF_CHUNKS = 0x01;
+        static boost::uint32_t const AVIIF_KEYFRAME = 0x10;
+        static boost::uint32_t const MAX_HEADER_LIST_SIZE = 16 * 1024 * 1024;
+
+        /* AviIndexCursor */
+
+        AviIndexCursor::AviIndexCursor(
+            AviIndex & index,
+            size_t istream)
+            : index_(index)
+            , istream_(istream)
+            , known_(0)
+            , ichunk_(0)
+            , ientry_(size_t(-1))
+        {
+            id_ = (boost::uint16_t)(('0' + istream / 10 % 10) | (('0' + istream % 10) << 8));
+            AviIndex::StreamHeader const & header = index_.streams_[istream_];
+            if (!header.super_index.empty()) {
+                chunks_ = header.super_index;
+                known_ = chunks_.size();
+            } else if (index_.has_idx1()) {
+                Chunk chunk;
+                chunk.offset = index_.idx1_offset_;
+                chunk.size = (boost::uint32_t)std::min<boost::uint64_t>(
+                    index_.idx1_size_, AviIndex::IDX1_PAGE_ENTRIES * 16);
+                chunk.dts = 0;
+                chunk.duration = 0;
+                chunks_.push_back(chunk);
+            }
+        }
+
+        boost::uint64_t AviIndexCursor::duration() const
+        {
+            if (!is_super() || chunks_.empty())
+                return 0;
+            return chunks_.back().dts + chunks_.back().duration;
+        }
+
+        bool AviIndexCursor::rewind(
+            boost::system::error_code & ec)
+        {
+            if (chunks_.empty()) {
+                ec = bad_media_format;
+                return false;
+            }
+            return load_chunk(0, ec) && next(ec);
+        }
+
+        bool AviIndexCursor::seek(
+            boost::uint64_t & dts,
+            boost::system::error_code & ec)
+        {
+            if (chunks_.empty()) {
+                ec = bad_media_format;
+                return false;
+            }
+            // idx1 pages are discovered on the way, time of a page is known after previous pages are loaded
+            while (!is_super()) {
+                if (known_ < chunks_.size()) {
+                    if (!load_chunk(chunks_.size() - 1, ec))
+                        return false;
+                    continue;
+                }
+                Chunk const & last = chunks_.back();
+                if (last.dts + last.duration > dts || !has_chunk(chunks_.size()))
+                    break;
+                if (!load_chunk(chunks_.size(), ec))
+                    return false;
+            }
+            size_t lo = 0;
+            size_t hi = chunks_.size();
+            while (lo + 1 < hi) {
+                size_t mid = (lo + hi) / 2;
+                if (chunks_[mid].dts <= dts) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+            if (!load_chunk(lo, ec))
+                return false;
+            if (entries_.empty()) {
+                // no entry of this stream in this idx1 page
+                if (!next(ec))
+                    return false;
+            } else {
+                size_t ientry = 0;
+                for (size_t i = 0; i < entries_.size() && entries_[i].dts <= dts; ++i) {
+                    if (entries_[i].key)
+                        ientry = i;
+                }
+                ientry_ = ientry;
+            }
+            dts = entries_[ientry_].dts;
+            ec.clear();
+            return true;
+        }
+
+        bool AviIndexCursor::prepare(
+            boost::system::error_code & ec)
+        {
+            ec.clear();
+            // ientry_ is size_t(-1) before first entry of chunk
+            while (ientry_ + 1 >= entries_.size()) {
+                if (!has_chunk(ichunk_ + 1))
+                    return true; // end of index, next() will fail
+                if (!load_chunk(ichunk_ + 1, ec))
+                    return false;
+            }
+            return true;
+        }
+
+        bool AviIndexCursor::next(
+            boost::system::error_code & ec)
+        {
+            if (!prepare(ec))
+                return false;
+            if (ientry_ + 1 >= entries_.size()) {
+                ec = end_of_stream;
+                return false;
+            }
+            ++ientry_;
+            return true;
+        }
+
+        bool AviIndexCursor::limit(
+            boost::uint64_t offset,
+            boost::uint64_t & dts,
+            boost::system::error_code & ec) const
+        {
+            ec.clear();
+            if (ientry_ >= entries_.size()) {
+                dts = chunks_.empty() ? 0 : chunks_[ichunk_].dts;
+                return true;
+            }
+            // only the loaded chunk is examined, we never read index to answer this
+            size_t i = ientry_;
+            dts = entries_[i].dts;
+            for (; i < entries_.size() && entries_[i].offset + entries_[i].size <= offset; ++i) {
+                dts = entries_[i].dts + entries_[i].duration;
+            }
+            return true;
+        }
+
+        void AviIndexCursor::get(
+            Sample & sample) const
+        {
+            assert(ientry_ < entries_.size());
+            Entry const & entry = entries_[ientry_];
+            sample.dts = entry.dts;
+            sample.cts_delta = 0;
+            sample.duration = entry.duration;
+            sample.time = entry.offset; // file offset, as just::avformat::AviStream does
+            sample.size = entry.size;
+            sample.flags = entry.key ? Sample::f_sync : 0;
+        }
+
+        bool AviIndexCursor::is_super() const
+        {
+            return !index_.streams_[istream_].super_index.empty();
+        }
+
+        bool AviIndexCursor::has_chunk(
+            size_t ichunk) const
+        {
+            if (ichunk < chunks_.size())
+                return true;
+            if (is_super() || known_ < chunks_.size())
+                return false;
+            Chunk const & last = chunks_.back();
+            return ichunk == chunks_.size()
+                && last.offset + last.size < index_.idx1_offset_ + index_.idx1_size_;
+        }
+
+        bool AviIndexCursor::load_chunk(
+            size_t ichunk,
+            boost::system::error_code & ec)
+        {
+            assert(ichunk <= chunks_.size());
+            Chunk chunk;
+            if (ichunk == chunks_.size()) {
+                // next idx1 page
+                Chunk const & last = chunks_.back();
+                chunk.offset = last.offset + last.size;
+                chunk.size = (boost::uint32_t)std::min<boost::uint64_t>(
+                    index_.idx1_offset_ + index_.idx1_size_ - chunk.offset, AviIndex::IDX1_FETCH_ENTRIES * 16);
+                chunk.dts = last.dts + last.duration;
+                chunk.duration = 0;
+            } else {
+                chunk = chunks_[ichunk];
+            }
+            // nothing changes if data is not ready, caller will retry
+            if (!index_.read(chunk.offset, chunk.size, true, ec))
+                return false;
+            if (ichunk == chunks_.size())
+                chunks_.push_back(chunk);
+            entries_.clear();
+            ichunk_ = ichunk;
+            ientry_ = size_t(-1);
+            if (is_super()) {
+                return parse_standard_index(chunk, ec);
+            }
+            parse_idx1_page(chunk);
+            if (known_ <= ichunk) {
+                chunks_[ichunk].duration = entries_.empty() ? 0
+                    : entries_.back().dts + entries_.back().duration - chunk.dts;
+                known_ = ichunk + 1;
+            }
+            ec.clear();
+            return true;
+        }
+
+        bool AviIndexCursor::parse_standard_index(
+            Chunk const & chunk,
+            boost::system::error_code & ec)
+        {
+            boost::uint8_t const * p = &index_.buffer_[0];
+            // ix## chunk header (8) + AVISTDINDEX header (24)
+            if (chunk.size < 32
+                || avi_le16(p + 8) != 2
+                || p[11] != AVI_INDEX_OF_CHUNKS) {
+                    LOG_WARN("[parse_standard_index] bad standard index at " << chunk.offset);
+                    ec = bad_media_format;
+                    return false;
+            }
+            boost::uint32_t n = avi_le32(p + 12);
+            boost::uint64_t base = avi_le64(p + 20);
+            if (32 + (boost::uint64_t)n * 8 > chunk.size) {
+                ec = bad_media_format;
+                return false;
+            }
+            p += 32;
+            boost::uint64_t dts = chunk.dts;
+            for (boost::uint32_t i = 0; i < n; ++i, p += 8) {
+                boost::uint32_t size = avi_le32(p + 4);
+                push_entry(base + avi_le32(p), size & 0x7fffffff, (size & 0x80000000) == 0, dts);
+            }
+            ec.clear();
+            return true;
+        }
+
+        void AviIndexCursor::parse_idx1_page(
+            Chunk const & chunk)
+        {
+            boost::uint8_t const * p = &index_.buffer_[0];
+            boost::uint8_t const * e = p + chunk.size / 16 * 16;
+            // offsets are relative to "movi" in most files, absolute in a few, decide with first entry
+            if (chunk.offset == index_.idx1_offset_ && chunk.size >= 16) {
+                index_.idx1_base_ = avi_le32(p + 8) < index_.movi_offset_ ? index_.movi_offset_ : 0;
+            }
+            boost::uint64_t dts = chunk.dts;
+            for (; p < e; p += 16) {
+                if (avi_le16(p) != id_) // other streams, "rec " lists
+                    continue;
+                // offset points to chunk header
+                push_entry(index_.idx1_base_ + avi_le32(p + 8) + 8, avi_le32(p + 12), 
+                    (avi_le32(p + 4) & AVIIF_KEYFRAME) != 0, dts);
+            }
+        }
+
+        void AviIndexCursor::push_entry(
+            boost::uint64_t offset,
+            boost::uint32_t size,
+            bool key, 
+            boost::uint64_t & dts)
+        {
+            AviIndex::StreamHeader const & header = index_.streams_[istream_];
+            Entry entry;
+            entry.offset = offset;
+            entry.size = size;
+            entry.duration = header.sample_size
+                ? (size + header.sample_size - 1) / header.sample_size * header.scale
+                : header.scale;
+            entry.dts = dts;
+            entry.key = key || header.type == AviIndex::ID_AUDS;
+            entries_.push_back(entry);
+            dts += entry.duration;
+        }
+
+        /* AviIndex */
+
+        AviIndex::AviIndex(
+            streambuffer_t & buf)
+            : buf_(buf)
+            , movi_offset_(0)
+            , idx1_base_(0)
+            , idx1_offset_(0)
+            , idx1_size_(0)
+            , fetch_offset_(boost::uint64_t(-1))
+        {
+        }
+
+        AviIndex::~AviIndex()
+        {
+            clear();
+        }
+
+        void AviIndex::clear()
+        {
+            for (size_t i = 0; i < cursors_.size(); ++i) {
+                delete cursors_[i];
+            }
+            cursors_.clear();
+            streams_.clear();
+            movi_offset_ = idx1_base_ = idx1_offset_ = idx1_size_ = 0;
+            fetch_offset_ = boost::uint64_t(-1);
+        }
+
+        bool AviIndex::peek(
+            boost::uint64_t offset,
+            ChunkHeader & header)
+        {
+            boost::system::error_code ec;
+            if (!read(offset, 8, false, ec))
+                return false;
+            header.id = avi_le32(&buffer_[0]);
+            header.size = avi_le32(&buffer_[4]);
+            header.type = 0;
+            if (header.id == ID_LIST || header.id == ID_RIFF) {
+                if (!read(offset + 8, 4, false, ec))
+                    return false;
+                header.type = avi_le32(&buffer_[0]);
+            }
+            return true;
+        }
+
+        bool AviIndex::parse_header_list(
+            boost::uint64_t offset,
+            boost::uint64_t size,
+            boost::system::error_code & ec)
+        {
+            if (size < 4 || size > MAX_HEADER_LIST_SIZE) {
+                ec = bad_media_format;
+                return false;
+            }
+            if (!read(offset, (size_t)size, false, ec))
+                return false;
+            std::vector<boost::uint8_t> data;
+            data.swap(buffer_);
+            streams_.clear();
+            boost::uint8_t const * p = &data[0];
+            boost::uint8_t const * e = p + (size_t)size;
+            boost::uint8_t const * strl_end = p;
+            while (p + 8 <= e) {
+                boost::uint32_t id = avi_le32(p);
+                boost::uint32_t len = avi_le32(p + 4);
+                if (id == ID_LIST && p + 12 <= e) {
+                    if (avi_le32(p + 8) == ID_STRL) {
+                        StreamHeader stream;
+                        stream.type = 0;
+                        stream.scale = 1;
+                        stream.sample_size = 0;
+                        streams_.push_back(stream);
+                        strl_end = p + 8 + len;
+                    }
+                    p += 12; // step into list
+                    continue;
+                }
+                if (len > (size_t)(e - p - 8))
+                    break;
+                if (!streams_.empty() && p < strl_end) {
+                    StreamHeader & stream = streams_.back();
+                    if (id == ID_STRH && len >= 48) {
+                        stream.type = avi_le32(p + 8);
+                        stream.scale = std::max<boost::uint32_t>(avi_le32(p + 8 + 20), 1);
+                        stream.sample_size = avi_le32(p + 8 + 44);
+                    } else if (id == ID_INDX) {
+                        parse_super_index(stream, p + 8, len);
+                    }
+                }
+                p += 8 + len + (len & 1);
+            }
+            data.swap(buffer_);
+            cursors_.assign(streams_.size(), NULL);
+            ec.clear();
+            return true;
+        }
+
+        void AviIndex::parse_super_index(
+            StreamHeader & stream,
+            boost::uint8_t const * p,
+            size_t size)
+        {
+            // AVISUPERINDEX: wLongsPerEntry, bIndexSubType, bIndexType, nEntriesInUse, dwChunkId, dwReserved[3]
+            if (size < 24 || avi_le16(p) != 4 || p[3] != AVI_INDEX_OF_INDEXES) {
+                LOG_WARN("[parse_super_index] unsupported index type");
+                return;
+            }
+            boost::uint32_t n = avi_le32(p + 4);
+            if (24 + (boost::uint64_t)n * 16 > size) {
+                LOG_WARN("[parse_super_index] truncated super index");
+                return;
+            }
+            p += 24;
+            boost::uint64_t dts = 0;
+            for (boost::uint32_t i = 0; i < n; ++i, p += 16) {
+                AviIndexCursor::Chunk chunk;
+                chunk.offset = avi_le64(p);
+                chunk.size = avi_le32(p + 8);
+                chunk.dts = dts;
+                chunk.duration = (boost::uint64_t)avi_le32(p + 12) * stream.scale;
+                if (chunk.offset == 0 || chunk.size == 0)
+                    continue;
+                stream.super_index.push_back(chunk);
+                dts += chunk.duration;
+            }
+        }
+
+        void AviIndex::movi(
+            boost::uint64_t offset)
+        {
+            movi_offset_ = offset;
+        }
+
+        void AviIndex::idx1(
+            boost::uint64_t offset,
+            boost::uint64_t size)
+        {
+            idx1_offset_ = offset;
+            idx1_size_ = size;
+        }
+
+        bool AviIndex::has_super_index() const
+        {
+            bool has = false;
+            for (size_t i = 0; i < streams_.size(); ++i) {
+                if (streams_[i].type != ID_VIDS && streams_[i].type != ID_AUDS)
+                    continue;
+                if (streams_[i].super_index.empty())
+                    return false;
+                has = true;
+            }
+            return has;
+        }
+
+        AviIndexCursor * AviIndex::cursor(
+            size_t istream)
+        {
+            if (istream >= streams_.size())
+                return NULL;
+            if (streams_[istream].super_index.empty() && !has_idx1())
+                return NULL;
+            if (cursors_[istream] == NULL)
+                cursors_[istream] = new AviIndexCursor(*this, istream);
+            return cursors_[istream];
+        }
+
+        bool AviIndex::rewind(
+            boost::system::error_code & ec)
+        {
+            for (size_t i = 0; i < cursors_.size(); ++i) {
+                if (cursors_[i] && !cursors_[i]->rewind(ec))
+                    return false;
+            }
+            ec.clear();
+            return true;
+        }
+
+        bool AviIndex::read(
+            boost::uint64_t offset,
+            size_t size,
+            bool fetch,
+            boost::system::error_code & ec)
+        {
+            // index chunks come from file, don't trust their size
+            if (size > MAX_HEADER_LIST_SIZE) {
+                ec = bad_media_format;
+                return false;
+            }
+            if (buffer_.size() < size)
+                buffer_.resize(size);
+            // keep read position of demuxer
+            std::streampos pos = buf_.pubseekoff(0, std::ios::cur, std::ios::in);
+            bool ok = buf_.pubseekpos((std::streamoff)offset, std::ios::in) == std::streampos((std::streamoff)offset)
+                && buf_.sgetn(&buffer_[0], size) == (std::streamsize)size;
+            if (ok && fetch_offset_ == offset) {
+                // fetch done, download from where demuxer reads again
+                fetch_offset_ = boost::uint64_t(-1);
+                buf_.pubseekpos(fetch_restore_, std::ios::in | std::ios::out);
+            } else if (!ok && fetch && fetch_offset_ != offset) {
+                // index chunk is far from buffered data, download it first
+                if (fetch_offset_ == boost::uint64_t(-1))
+                    fetch_restore_ = pos;
+                fetch_offset_ = offset;
+                LOG_DEBUG("[read] fetch index at " << offset << ", size " << size);
+                buf_.pubseekpos((std::streamoff)offset, std::ios::in | std::ios::out);
+            } else {
+                buf_.pubseekpos(pos, std::ios::in);
+            }
+            if (ok) {
+                ec.clear();
+            } else {
+                ec = file_stream_error;
+            }
+            return ok;
+        }
+
+    } // namespace demux
+} // namespace just
@@ -0,0 +1,223 @@
+// AviIndex.h
+
+#ifndef _JUST_DEMUX_BASIC_AVI_AVI_INDEX_H_
+#define _JUST_DEMUX_BASIC_AVI_AVI_INDEX_H_
+
+#include "just/demux/base/DemuxBase.h"
+
+namespace just
+{
+    namespace demux
+    {
+
+        class AviIndex;
+
+        // Index of one stream, loaded one index chunk at a time
+        // chunks are either OpenDML standard indexes (ix##), located by the super index (indx),
+        // or fixed size pages of the legacy idx1 list
+        class AviIndexCursor
+        {
+        public:
+            struct Chunk
+            {
+                boost::uint64_t offset;
+                boost::uint32_t size;
+                boost::uint64_t dts;
+                boost::uint64_t duration;
+            };
+
+            struct Entry
+            {
+                boost::uint64_t offset;
+                boost::uint32_t size;
+                boost::uint32_t duration;
+                boost::uint64_t dts;
+                bool key;
+            };
+
+        public:
+            AviIndexCursor(
+                AviIndex & index,
+                size_t istream);
+
+        public:
+            // time span of super index, 0 for idx1
+            boost::uint64_t duration() const;
+
+            // position at first entry
+            bool rewind(
+                boost::system::error_code & ec);
+
+            // position at last key entry before dts, dts is updated
+            bool seek(
+                boost::uint64_t & dts,
+                boost::system::error_code & ec);
+
+            // make sure next entry is loaded, may read one index chunk
+            bool prepare(
+                boost::system::error_code & ec);
+
+            bool next(
+                boost::system::error_code & ec);
+
+            bool limit(
+                boost::uint64_t offset,
+                boost::uint64_t & dts,
+                boost::system::error_code & ec) const;
+
+            void get(
+                Sample & sample) const;
+
+        private:
+            friend class AviIndex;
+
+            bool is_super() const;
+
+            bool has_chunk(
+                size_t ichunk) const;
+
+            bool load_chunk(
+                size_t ichunk,
+                boost::system::error_code & ec);
+
+            bool parse_standard_index(
+                Chunk const & chunk,
+                boost::system::error_code & ec);
+
+            void parse_idx1_page(
+                Chunk const & chunk);
+
+            void push_entry(
+                boost::uint64_t offset,
+                boost::uint32_t size,
+                bool key,
+                boost::uint64_t & dts);
+
+        private:
+            AviIndex & index_;
+            size_t istream_;
+            boost::uint16_t id_; // two digits of chunk id, for idx1
+            std::vector<Chunk> chunks_;
+            size_t known_; // chunks with known duration
+            std::vector<Entry> entries_;
+            size_t ichunk_;
+            size_t ientry_;
+        };
+
+        class AviIndex
+        {
+        public:
+            typedef std::basic_streambuf<boost::uint8_t> streambuffer_t;
+
+            struct ChunkHeader
+            {
+                boost::uint32_t id;
+                boost::uint32_t type; // list type, valid when id is LIST
+                boost::uint64_t size;
+            };
+
+        public:
+            AviIndex(
+                streambuffer_t & buf);
+
+            ~AviIndex();
+
+        public:
+            // read chunk header at offset, return false if data is not ready
+            bool peek(
+                boost::uint64_t offset,
+                ChunkHeader & header);
+
+            // scan "hdrl" list for stream headers and OpenDML super indexes
+            bool parse_header_list(
+                boost::uint64_t offset,
+                boost::uint64_t size,
+                boost::system::error_code & ec);
+
+            // offset of "movi" list type, base of relative idx1 offsets
+            void movi(
+                boost::uint64_t offset);
+
+            void idx1(
+                boost::uint64_t offset,
+                boost::uint64_t size);
+
+            void clear();
+
+        public:
+            bool has_header() const
+            {
+                return !streams_.empty();
+            }
+
+            // every audio/video stream has an OpenDML super index
+            bool has_super_index() const;
+
+            bool has_idx1() const
+            {
+                return idx1_size_ > 0;
+            }
+
+            // by stream order in header list
+            AviIndexCursor * cursor(
+                size_t istream);
+
+            bool rewind(
+                boost::system::error_code & ec);
+
+        public:
+            static boost::uint32_t const ID_RIFF = 0x46464952; // "RIFF"
+            static boost::uint32_t const ID_LIST = 0x5453494c; // "LIST"
+            static boost::uint32_t const ID_HDRL = 0x6c726468; // "hdrl"
+            static boost::uint32_t const ID_STRL = 0x6c727473; // "strl"
+            static boost::uint32_t const ID_STRH = 0x68727473; // "strh"
+            static boost::uint32_t const ID_INDX = 0x78646e69; // "indx"
+            static boost::uint32_t const ID_IDX1 = 0x31786469; // "idx1"
+            static boost::uint32_t const ID_VIDS = 0x73646976; // "vids"
+            static boost::uint32_t const ID_AUDS = 0x73647561; // "auds"
+
+            static size_t const IDX1_PAGE_ENTRIES = 4096;
+            // later idx1 pages are fetched with a range request, take more at a time
+            static size_t const IDX1_FETCH_ENTRIES = 65536;
+
+        private:
+            friend class AviIndexCursor;
+
+            struct StreamHeader
+            {
+                boost::uint32_t type;
+                boost::uint32_t scale;
+                boost::uint32_t sample_size;
+                std::vector<AviIndexCursor::Chunk> super_index;
+            };
+
+            // with fetch, data not in buffer is requested by moving download position,
+            // which is restored after the data is read
+            bool read(
+                boost::uint64_t offset,
+                size_t size,
+                bool fetch,
+                boost::system::error_code & ec);
+
+            void parse_super_index(
+                StreamHeader & stream,
+                boost::uint8_t const * p,
+                size_t size);
+
+        private:
+            streambuffer_t & buf_;
+            std::vector<StreamHeader> streams_;
+            std::vector<AviIndexCursor *> cursors_;
+            boost::uint64_t movi_offset_;
+            boost::uint64_t idx1_base_;
+            boost::uint64_t idx1_offset_;
+            boost::uint64_t idx1_size_;
+            std::vector<boost::uint8_t> buffer_; // reused for every index read
+            boost::uint64_t fetch_offset_; // index chunk being downloaded, -1 if none
+            std::streampos fetch_restore_; // read position of demuxer before fetch
+        };
+
+    } // namespace demux
+} // namespace just
+
+#endif // _JUST_DEMUX_BASIC_AVI_AVI_INDEX_H_
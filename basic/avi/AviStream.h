@@ -8,6 +8,8 @@
 #include <just/avformat/avi/lib/AviStream.h>
 #include <just/avformat/avi/box/AviBoxEnum.h>
 
+#include "just/demux/basic/avi/AviIndex.h"
+
 #include <just/avcodec/CodecType.h>
 #include <just/avcodec/avc/AvcFormatType.h>
 #include <just/avcodec/aac/AacFormatType.h>
@@ -27,9 +29,11 @@ namespace just
             AviStream(
                 size_t istream, 
                 just::avformat::AviStream & stream, 
-                TimestampHelper & helper)
+                TimestampHelper & helper, 
+                AviIndexCursor * cursor = NULL)
                 : stream_(stream)
                 , helper_(helper)
+                , cursor_(cursor)
                 , time_(0)
                 , offset_(0)
             {
@@ -37,6 +41,9 @@ namespace just
                 time_scale = stream_.timescale();
                 start_time = 0;
                 duration = stream_.duration();
+                // header length covers only first RIFF of OpenDML files
+                if (cursor_ && cursor_->duration() > duration)
+                    duration = cursor_->duration();
                 if (!helper_.empty())
                     update();
             }
@@ -57,12 +64,26 @@ namespace just
                 boost::uint64_t & time, 
                 boost::system::error_code & ec)
             {
+                if (cursor_)
+                    return cursor_->seek(time, ec) && update();
                 return stream_.seek(time, ec) && update();
             }
 
+            // load index needed by next_sample, false with file_stream_error if not ready
+            bool prepare_next(
+                boost::system::error_code & ec)
+            {
+                if (cursor_)
+                    return cursor_->prepare(ec);
+                ec.clear();
+                return true;
+            }
+
             bool next_sample(
                 boost::system::error_code & ec)
             {
+                if (cursor_)
+                    return cursor_->next(ec) && update();
                 return stream_.next(ec) && update();
             }
 
@@ -71,6 +92,8 @@ namespace just
                 boost::uint64_t & time, 
                 boost::system::error_code & ec)
             {
+                if (cursor_)
+                    return cursor_->limit(offset, time, ec);
                 return stream_.limit(offset, time, ec);
             }
 
@@ -113,7 +136,10 @@ namespace just
         private:
             bool update()
             {
-                stream_.get(sample_);
+                if (cursor_)
+                    cursor_->get(sample_);
+                else
+                    stream_.get(sample_);
                 time_ = helper_.const_adjust(index, sample_.dts);
                 offset_ = sample_.time;
                 return true;
@@ -160,6 +186,7 @@ namespace just
         private:
             just::avformat::AviStream & stream_;
             TimestampHelper & helper_;
+            AviIndexCursor * cursor_; // lazy index, NULL when index is loaded by just::avformat
             Sample sample_;
             boost::uint64_t time_; // 
             boost::uint64_t offset_;
@@ -86,6 +86,7 @@ namespace just
                     streams_.resize(n);
                     open_step_ = 1;
                     parse_offset_ = std::ios::off_type(flv_header_.DataOffset) + 4; // + 4 PreTagSize
+                    open_stream_beg();
                     header_offset_ = parse_offset_;
                 } else {
                     if (archive_.failed()) {
@@ -87,6 +87,9 @@ namespace just
                         MkvTrackEntry const & track = segment.Tracks.Tracks[i];
                         MkvStream stream(file_prop_, track);
                         stream.index = streams_.size();
+                        if (stream.has_unsupported_encoding()) {
+                            LOG_WARN("[is_open] unsupported content encoding, track = " << track.TrackNumber.value());
+                        }
                         if (stream_map_.size() <= (size_t)track.TrackNumber.value()) {
                             stream_map_.resize((size_t)track.TrackNumber.value() + 1, size_t(-1));
                             stream_map_[(size_t)track.TrackNumber.value()] = streams_.size();
@@ -225,21 +228,10 @@ namespace just
             BasicDemuxer::push_data(object_parse_.offset(), sample.size);
             object_parse_.next();
             sample.data.clear();
-            for (size_t i = 0; i < stream.ContentEncodings.ContentEncodings.size(); ++i) {
-                MkvContentEncoding const & encoding = stream.ContentEncodings.ContentEncodings[i];
-                if (encoding.ContentEncodingType == 0) { // compression
-                    switch (encoding.ContentCompression.ContentCompAlgo.value()) {
-                        case 3: // header striping
-                            sample.size += encoding.ContentCompression.ContentCompSettings.value().size();
-                            sample.data.push_back(boost::asio::buffer(encoding.ContentCompression.ContentCompSettings.value()));
-                            break;
-                        default:
-                            LOG_WARN("[get_sample] unsupported compression algorithm: " << encoding.ContentCompression.ContentCompAlgo.value());
-                            break;
-                    }
-                } else {
-                    LOG_WARN("[get_sample] unsupported encryption");
-                }
+            if (stream.has_header_strip()) {
+                boost::asio::const_buffer strip = stream.header_strip();
+                sample.size += boost::asio::buffer_size(strip);
+                sample.data.push_back(strip);
             }
             BasicDemuxer::end_sample(sample);
             ec.clear();
@@ -24,10 +24,14 @@ namespace just
             , stream_map_(stream_map)
             , offset_(0)
             , end_(0)
+            , track_number_(0)
+            , time_code_(0)
+            , flags_(0)
             , cluster_end_(0)
             , offset_block_(0)
             , size_block_(0)
             , frame_(0)
+            , frame_count_(0)
             , in_group_(false)
             , duration_(0)
         {
@@ -39,11 +43,11 @@ namespace just
             offset_ = off;
             end_ = 0;
             header_.clear();
-            block_.sizes.clear();
             cluster_end_ = 0;
             offset_block_ = 0;
             size_block_ = 0;
             frame_= 0;
+            frame_count_ = 0;
             in_group_ = false;
             duration_ = 0;
         }
@@ -52,14 +56,14 @@ namespace just
             just::avformat::EBML_IArchive & ar, 
             boost::system::error_code & ec)
         {
-            if (frame_ >= block_.sizes.size()) {
-                block_.sizes.clear();
+            if (frame_ >= frame_count_) {
+                frame_count_ = 0;
                 if (!next_block(ar, ec))
                     return false;
                 duration_ = (boost::int16_t)streams_[itrack()].sample_duration();
             }
 
-            ar.seekg(offset_block_ + block_.sizes[frame_], std::ios::beg);
+            ar.seekg(offset_block_ + sizes_[frame_], std::ios::beg);
             if (ar) {
                 return true;
             } else {
@@ -71,8 +75,8 @@ namespace just
 
         void MkvParse::next()
         {
-            block_.TimeCode += duration_;
-            offset_block_ += block_.sizes[frame_];
+            time_code_ += duration_;
+            offset_block_ += sizes_[frame_];
             ++frame_;
         }
 
@@ -117,14 +121,10 @@ namespace just
                 } else if (in_group_) {
                     switch ((boost::uint32_t)header.Id) {
                         case MkvBlock::StaticId:
-                            ar >> block_;
-                            if (ar) {
-                                offset_block_ = ar.tellg();
-                                size_block_ = (boost::uint32_t)(data_end - offset_block_);
-                                block_.compelte_load(size_block_);
-                                frame_ = 0;
-                            } else {
-                                frame_ = block_.sizes.size();
+                            if (!load_block(ar, data_offset, data_end, ec)) {
+                                ar.clear();
+                                ar.seekg(offset_, std::ios::beg);
+                                return false;
                             }
                             break;
                         case 0x7B: // MkvBlockGroup::ReferenceBlock
@@ -156,14 +156,10 @@ namespace just
                             cluster_.Position.load_value(ar);
                             break;
                         case MkvSimpleBlock::StaticId:
-                            ar >> block_;
-                            if (ar) {
-                                offset_block_ = ar.tellg();
-                                size_block_ = (boost::uint32_t)(data_end - offset_block_);
-                                block_.compelte_load(size_block_);
-                                frame_ = 0;
-                            } else {
-                                frame_ = block_.sizes.size();
+                            if (!load_block(ar, data_offset, data_end, ec)) {
+                                ar.clear();
+                                ar.seekg(offset_, std::ios::beg);
+                                return false;
                             }
                             break;
                         case MkvBlockGroup::StaticId:
@@ -189,7 +185,7 @@ namespace just
                         }
                     }
                     offset_ = data_end;
-                    if (!block_.sizes.empty()) {
+                    if (frame_count_ > 0) {
                         break;
                     }
                 } else {
@@ -197,7 +193,7 @@ namespace just
                 }
             }
             if (ar) {
-                assert(!block_.sizes.empty());
+                assert(frame_count_ > 0);
                 return true;
             } else {
                 if (ar.failed()) {
@@ -212,5 +208,178 @@ namespace just
             }
         }
 
+        namespace detail
+        {
+
+            class MkvBlockReader
+            {
+            public:
+                MkvBlockReader(
+                    std::basic_streambuf<boost::uint8_t> & buf, 
+                    boost::uint64_t size)
+                    : buf_(buf)
+                    , left_(size)
+                    , eof_(false)
+                {
+                }
+
+            public:
+                bool get(
+                    boost::uint8_t & b)
+                {
+                    typedef std::basic_streambuf<boost::uint8_t>::traits_type traits_type;
+                    if (left_ == 0)
+                        return false;
+                    traits_type::int_type c = buf_.sbumpc();
+                    if (traits_type::eq_int_type(c, traits_type::eof())) {
+                        eof_ = true;
+                        return false;
+                    }
+                    b = traits_type::to_char_type(c);
+                    --left_;
+                    return true;
+                }
+
+                // EBML variable size integer, marker bit removed
+                bool get_vint(
+                    boost::uint64_t & v, 
+                    size_t & len)
+                {
+                    boost::uint8_t b = 0;
+                    if (!get(b) || b == 0)
+                        return false;
+                    len = 1;
+                    boost::uint8_t mask = 0x80;
+                    while ((b & mask) == 0) {
+                        mask >>= 1;
+                        ++len;
+                    }
+                    v = b & (mask - 1);
+                    for (size_t i = 1; i < len; ++i) {
+                        if (!get(b))
+                            return false;
+                        v = (v << 8) | b;
+                    }
+                    return true;
+                }
+
+                boost::uint64_t left() const
+                {
+                    return left_;
+                }
+
+                boost::system::error_code error() const
+                {
+                    return eof_ ? file_stream_error : bad_media_format;
+                }
+
+            private:
+                std::basic_streambuf<boost::uint8_t> & buf_;
+                boost::uint64_t left_;
+                bool eof_;
+            };
+
+        } // namespace detail
+
+        bool MkvParse::load_block(
+            just::avformat::EBML_IArchive & ar, 
+            boost::uint64_t data_offset, 
+            boost::uint64_t data_end, 
+            boost::system::error_code & ec)
+        {
+            detail::MkvBlockReader reader(*ar.rdbuf(), data_end - data_offset);
+            size_t len = 0;
+            boost::uint8_t b0 = 0;
+            boost::uint8_t b1 = 0;
+            if (!reader.get_vint(track_number_, len)
+                || !reader.get(b0)
+                || !reader.get(b1)
+                || !reader.get(flags_)) {
+                    ec = reader.error();
+                    return false;
+            }
+            time_code_ = (boost::int16_t)(((boost::uint16_t)b0 << 8) | b1);
+            frame_ = 0;
+
+            if ((flags_ & 0x06) == 0) { // no lacing, most video and simple blocks
+                frame_count_ = 1;
+                sizes_[0] = (boost::uint32_t)reader.left();
+                offset_block_ = data_end - reader.left();
+                size_block_ = sizes_[0];
+                return true;
+            }
+
+            boost::uint8_t count = 0;
+            if (!reader.get(count)) {
+                ec = reader.error();
+                return false;
+            }
+            size_t n = (size_t)count + 1;
+            boost::uint64_t total = 0;
+            switch (flags_ & 0x06) {
+                case 0x02: // Xiph lacing
+                    for (size_t i = 0; i + 1 < n; ++i) {
+                        boost::uint32_t size = 0;
+                        boost::uint8_t b = 0xff;
+                        while (b == 0xff) {
+                            if (!reader.get(b)) {
+                                ec = reader.error();
+                                return false;
+                            }
+                            size += b;
+                        }
+                        sizes_[i] = size;
+                        total += size;
+                    }
+                    break;
+                case 0x06: // EBML lacing
+                    if (n > 1) {
+                        boost::uint64_t v = 0;
+                        if (!reader.get_vint(v, len)) {
+                            ec = reader.error();
+                            return false;
+                        }
+                        boost::int64_t size = (boost::int64_t)v;
+                        sizes_[0] = (boost::uint32_t)size;
+                        total = sizes_[0];
+                        for (size_t i = 1; i + 1 < n; ++i) {
+                            if (!reader.get_vint(v, len)) {
+                                ec = reader.error();
+                                return false;
+                            }
+                            // signed difference, biased by 2^(7*len-1) - 1
+                            size += (boost::int64_t)v - (((boost::int64_t)1 << (len * 7 - 1)) - 1);
+                            if (size < 0) {
+                                ec = bad_media_format;
+                                return false;
+                            }
+                            sizes_[i] = (boost::uint32_t)size;
+                            total += sizes_[i];
+                        }
+                    }
+                    break;
+                default: // 0x04 fixed-size lacing
+                    if (reader.left() % n) {
+                        ec = bad_media_format;
+                        return false;
+                    }
+                    for (size_t i = 0; i + 1 < n; ++i) {
+                        sizes_[i] = (boost::uint32_t)(reader.left() / n);
+                        total += sizes_[i];
+                    }
+                    break;
+            }
+            if (total > reader.left()) {
+                LOG_WARN("[load_block] lace sizes excced block size");
+                ec = bad_media_format;
+                return false;
+            }
+            sizes_[n - 1] = (boost::uint32_t)(reader.left() - total);
+            frame_count_ = n;
+            offset_block_ = data_end - reader.left();
+            size_block_ = (boost::uint32_t)reader.left();
+            return true;
+        }
+
     } // namespace demux
 } // namespace just
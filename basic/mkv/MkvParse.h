@@ -32,8 +32,8 @@ namespace just
         public:
             boost::uint32_t itrack() const
             {
-                return (boost::uint32_t)block_.TrackNumber < stream_map_.size() 
-                    ? stream_map_[block_.TrackNumber] : boost::uint32_t(-1);
+                return track_number_ < stream_map_.size() 
+                    ? (boost::uint32_t)stream_map_[(size_t)track_number_] : boost::uint32_t(-1);
             }
 
             boost::uint64_t offset() const
@@ -43,12 +43,12 @@ namespace just
 
             boost::uint32_t size() const
             {
-                return block_.sizes[frame_];
+                return sizes_[frame_];
             }
 
             boost::uint64_t pts() const
             {
-                return cluster_.TimeCode.value() + block_.TimeCode;
+                return cluster_.TimeCode.value() + time_code_;
             }
 
             boost::uint32_t duration() const
@@ -63,7 +63,7 @@ namespace just
 
             bool is_sync_frame() const
             {
-                return block_.Keyframe == 1;
+                return (flags_ & 0x80) != 0;
             }
 
         private:
@@ -71,6 +71,17 @@ namespace just
                 just::avformat::EBML_IArchive & ar, 
                 boost::system::error_code & ec);
 
+            // parse block header and lace sizes into sizes_, no heap allocation
+            bool load_block(
+                just::avformat::EBML_IArchive & ar, 
+                boost::uint64_t data_offset, 
+                boost::uint64_t data_end, 
+                boost::system::error_code & ec);
+
+        private:
+            // lace count is stored in one byte (count - 1)
+            static size_t const MAX_LACE_FRAMES = 256;
+
         private:
             std::vector<MkvStream> & streams_;
             std::vector<size_t> & stream_map_;
@@ -78,12 +89,16 @@ namespace just
             boost::uint64_t end_;
             just::avformat::EBML_ElementHeader header_;
             just::avformat::MkvClusterData cluster_;
-            just::avformat::MkvBlockData block_;
+            boost::uint64_t track_number_;
+            boost::int32_t time_code_;
+            boost::uint8_t flags_;
             just::avformat::MkvBlockGroup group_;
             boost::uint64_t cluster_end_;
             boost::uint64_t offset_block_;
             boost::uint32_t size_block_;
             size_t frame_;
+            size_t frame_count_;
+            boost::uint32_t sizes_[MAX_LACE_FRAMES];
             bool in_group_;
             boost::int16_t duration_;
         };
@@ -22,6 +22,8 @@ namespace just
                 : time_code_scale_(1)
                 , dts_orgin_(0)
                 , dts_(0)
+                , header_strip_(size_t(-1))
+                , unsupported_encoding_(false)
             {
                 index = (boost::uint32_t)-1;
             }
@@ -32,6 +34,8 @@ namespace just
                 : just::avformat::MkvTrackEntryData(track)
                 , dts_orgin_(0)
                 , dts_(0)
+                , header_strip_(size_t(-1))
+                , unsupported_encoding_(false)
             {
                 index = (boost::uint32_t)-1;
                 time_code_scale_ = (boost::uint32_t)file_prop.Time_Code_Scale.value();
@@ -67,12 +71,47 @@ namespace just
                 dts_ = dts;
             }
 
+            bool has_header_strip() const
+            {
+                return header_strip_ != size_t(-1);
+            }
+
+            // bytes removed from each frame by header stripping compression
+            boost::asio::const_buffer header_strip() const
+            {
+                assert(has_header_strip());
+                return boost::asio::buffer(ContentEncodings.ContentEncodings[header_strip_]
+                    .ContentCompression.ContentCompSettings.value());
+            }
+
+            // unsupported compression or encryption present, logged once at open
+            bool has_unsupported_encoding() const
+            {
+                return unsupported_encoding_;
+            }
+
         private:
+            void parse_encodings()
+            {
+                unsupported_encoding_ = false;
+                for (size_t i = 0; i < ContentEncodings.ContentEncodings.size(); ++i) {
+                    just::avformat::MkvContentEncoding const & encoding = ContentEncodings.ContentEncodings[i];
+                    if (encoding.ContentEncodingType == 0 
+                        && encoding.ContentCompression.ContentCompAlgo.value() == 3 // header striping
+                        && header_strip_ == size_t(-1)) {
+                            header_strip_ = i;
+                    } else {
+                        unsupported_encoding_ = true;
+                    }
+                }
+            }
+
             void parse()
             {
                 using namespace just::avformat;
                 boost::system::error_code ec;
 
+                parse_encodings();
                 time_scale = (boost::uint32_t)(1000000000 / time_code_scale_);
                 format_data = CodecPrivate.value();
                 context = CodecID.value().c_str();
@@ -102,6 +141,8 @@ namespace just
             boost::uint32_t time_code_scale_;
             boost::uint64_t dts_orgin_;
             boost::uint64_t dts_;
+            size_t header_strip_; // index in ContentEncodings
+            bool unsupported_encoding_;
         };
 
     } // namespace demux
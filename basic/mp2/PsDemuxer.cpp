@@ -91,6 +91,7 @@ namespace just
                         }
                         header_offset_ = parse_.offset;
                         open_step_ = 1;
+                        open_stream_beg();
                     }
                 } else {
                     if (archive_.failed()) {
@@ -76,6 +76,24 @@ namespace just
             archive_.seekg(parse_.offset, std::ios_base::beg);
             assert(archive_);
 
+            if (open_step_ == 0 && parse_.offset == 0) {
+                // skip garbage before first packet
+                boost::uint8_t hbytes[TsPacket::PACKET_SIZE * 8];
+                size_t hsize = archive_.rdbuf()->sgetn(hbytes, sizeof(hbytes));
+                size_t count = 0;
+                size_t offset = sync_offset(hbytes, hsize, count);
+                if (count == 0) {
+                    ec = hsize < sizeof(hbytes) ? file_stream_error : bad_media_format;
+                    archive_.seekg(0, std::ios_base::beg);
+                    return false;
+                }
+                if (offset > 0) {
+                    LOG_DEBUG("[is_open] skip bytes: " << offset);
+                }
+                parse_.offset = parse2_.offset = offset;
+                archive_.seekg(parse_.offset, std::ios_base::beg);
+            }
+
             if (open_step_ == 0) {
                 while (get_packet(parse_, ec)) {
                     if (parse_.pkt.pid != TsPid::pat) {
@@ -135,6 +153,7 @@ namespace just
                     }
                     open_step_ = 2;
                     header_offset_ = parse_.offset;
+                    open_stream_beg();
                     break;
                 }
             }
@@ -325,18 +344,43 @@ namespace just
             boost::uint8_t const * hbytes, 
             size_t hsize)
         {
-            boost::uint32_t scope = 0;
-            for (size_t i = 0; i < hsize; i += TsPacket::PACKET_SIZE) {
-                if (hbytes[i] == 0x47) {
-                    ++scope;
-                }
+            size_t count = 0;
+            size_t offset = sync_offset(hbytes, hsize, count);
+            if (count == 0) {
+                return 0;
+            }
+            // five continuous packets are enough
+            boost::uint32_t scope = SCOPE_MAX * (boost::uint32_t)(count < 5 ? count : 5) / 5;
+            if (offset + count * TsPacket::PACKET_SIZE < hsize) {
+                // sync lost inside window
+                scope /= 4;
             }
-            if (scope > SCOPE_MAX) {
-                scope = SCOPE_MAX;
+            if (offset > 0) {
+                scope /= 2;
             }
             return scope;
         }
 
+        size_t TsDemuxer::sync_offset(
+            boost::uint8_t const * hbytes, 
+            size_t hsize, 
+            size_t & count)
+        {
+            size_t max_offset = 0;
+            count = 0;
+            for (size_t offset = 0; offset < hsize && offset < TsPacket::PACKET_SIZE; ++offset) {
+                size_t n = 0;
+                for (size_t i = offset; i < hsize && hbytes[i] == 0x47; i += TsPacket::PACKET_SIZE) {
+                    ++n;
+                }
+                if (n > count) {
+                    max_offset = offset;
+                    count = n;
+                }
+            }
+            return max_offset;
+        }
+
         boost::uint64_t TsDemuxer::get_cur_time(
             error_code & ec) const
         {
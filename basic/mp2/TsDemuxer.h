@@ -76,6 +76,12 @@ namespace just
                 boost::uint8_t const * hbytes, 
                 size_t hsize);
 
+            // offset of longest run of sync bytes, run length in count
+            static size_t sync_offset(
+                boost::uint8_t const * hbytes, 
+                size_t hsize, 
+                size_t & count);
+
             virtual boost::uint64_t get_cur_time(
                 boost::system::error_code & ec) const;
 
@@ -100,6 +106,11 @@ namespace just
 
             virtual void joint_end();
 
+            virtual bool joint_carry() const
+            {
+                return true;
+            }
+
         private:
             bool is_open(
                 boost::system::error_code & ec) const;
@@ -302,12 +302,39 @@ namespace just
             boost::uint8_t const * header, 
             size_t hsize)
         {
+            // ISO base media brands handled by Mp4Demuxer
+            static char const * const brands[] = {
+                "isom", "iso2", "iso3", "iso4", "iso5", "iso6", "iso7", "iso8", "iso9", 
+                "mp41", "mp42", "mp71", "avc1", "M4V ", "M4VH", "M4VP", "M4A ", "M4B ", 
+                "f4v ", "f4a ", "dash", "msdh", "msix", "cmfc", "cmf2", 
+                "3gp4", "3gp5", "3gp6", "3g2a", "mmp4", "MSNV", "NDAS", 
+            };
             if (hsize < 12)
                 return 0;
-            if (memcmp(header + 4, "ftypisom", 8) == 0) {
-                return SCOPE_MAX;
+            if (memcmp(header + 4, "ftyp", 4) != 0) {
+                // old files without ftyp box
+                if (memcmp(header + 4, "moov", 4) == 0
+                    || memcmp(header + 4, "mdat", 4) == 0
+                    || memcmp(header + 4, "wide", 4) == 0
+                    || memcmp(header + 4, "free", 4) == 0) {
+                        return SCOPE_MAX / 4;
+                }
+                return 0;
+            }
+            size_t ftyp_size = ((size_t)header[0] << 24) | ((size_t)header[1] << 16) 
+                | ((size_t)header[2] << 8) | (size_t)header[3];
+            if (ftyp_size > hsize)
+                ftyp_size = hsize;
+            // major brand at 8, compatible brands from 16
+            for (size_t i = 8; i + 4 <= ftyp_size; i += (i == 8 ? 8 : 4)) {
+                for (size_t j = 0; j < sizeof(brands) / sizeof(brands[0]); ++j) {
+                    if (memcmp(header + i, brands[j], 4) == 0) {
+                        return i == 8 ? SCOPE_MAX : SCOPE_MAX - 1;
+                    }
+                }
             }
-            return 0;
+            // unknown brand, quicktime for example
+            return SCOPE_MAX / 2;
         }
 
         boost::uint64_t Mp4Demuxer::get_cur_time(
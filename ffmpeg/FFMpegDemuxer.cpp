@@ -18,11 +18,17 @@ using namespace just::avformat::error;
 #include <framework/logger/Logger.h>
 #include <framework/logger/StreamRecord.h>
 #include <framework/system/ErrorCode.h>
+#include <framework/string/Format.h>
 
 #include <boost/bind.hpp>
 #include <boost/dynamic_bitset.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <bitset>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
 
 extern "C" {
 #define UINT64_C(c)   c ## ULL
@@ -38,6 +44,12 @@ namespace just
     namespace demux
     {
 
+        struct PacketLock
+            : just::data::MemoryLock
+        {
+            AVPacket packet;
+        };
+
         FFMpegDemuxer::FFMpegDemuxer(
             boost::asio::io_service & io_svc, 
             just::data::MediaBase & media)
@@ -45,15 +57,28 @@ namespace just
             , media_(media)
             , source_(NULL)
             , buffer_(NULL)
-            , mem_lock_pool_(framework::memory::PrivateMemory(), 1024 * 1024, sizeof(just::data::MemoryLock))
+            , mem_lock_pool_(framework::memory::PrivateMemory(), 1024 * 1024, sizeof(PacketLock))
             , avf_ctx_(NULL)
+            , avio_ctx_(NULL)
             , start_time_(0)
             , seek_time_(0)
             , seek_pending_(false)
             , open_state_(closed)
+            , canceled_(false)
+            , io_buffer_size_(32 * 1024)
+            , probe_size_(5000000)
+            , analyze_duration_(5000)
+            , max_peek_packets_(200)
         {
             just::avcodec::ffmpeg_log_setup();
             av_register_all();
+
+            config_.register_module("FFMpeg")
+                << CONFIG_PARAM_NAME_RDWR("io_buffer_size", io_buffer_size_)
+                << CONFIG_PARAM_NAME_RDWR("probe_size", probe_size_)
+                << CONFIG_PARAM_NAME_RDWR("analyze_duration", analyze_duration_)
+                << CONFIG_PARAM_NAME_RDWR("max_peek_packets", max_peek_packets_)
+                << CONFIG_PARAM_NAME_RDWR("info_cache_path", info_cache_path_);
         }
 
         FFMpegDemuxer::~FFMpegDemuxer()
@@ -70,8 +95,10 @@ namespace just
             open_response_type const & resp)
         {
             resp_ = resp;
-            boost::system::error_code ec;
-            handle_async_open(ec);
+            canceled_ = false;
+            // same strand as later steps of open, they may run on a worker thread
+            strand().post(
+                boost::bind(&FFMpegDemuxer::handle_async_open, this, boost::system::error_code()));
         }
 
         bool FFMpegDemuxer::is_open(
@@ -98,6 +125,8 @@ namespace just
         boost::system::error_code FFMpegDemuxer::cancel(
             boost::system::error_code & ec)
         {
+            // av_read_frame may be waiting in just_read on another thread
+            canceled_ = true;
             if (media_open == open_state_) {
                 media_.cancel(ec);
             } else if (demuxer_open == open_state_) {
@@ -110,10 +139,15 @@ namespace just
             boost::system::error_code & ec)
         {
             DemuxStatistic::close();
+            free_peek_packets();
             if (open_state_ > demuxer_open) {
                 on_close();
                 avformat_close_input(&avf_ctx_);
             }
+            if (avio_ctx_) {
+                buffer_avio_close(avio_ctx_);
+                avio_ctx_ = NULL;
+            }
             if (open_state_ > media_open) {
                 media_.close(ec);
             }
@@ -122,10 +156,10 @@ namespace just
             open_state_ = closed;
 
             if (buffer_) {
-                remove_buffer(*buffer_);
                 delete buffer_;
                 buffer_ = NULL;
             }
+            release_buffer();
             if (source_) {
                 source_->close(ec);
                 util::stream::UrlSource * source = const_cast<util::stream::UrlSource *>(&source_->source());
@@ -143,20 +177,25 @@ namespace just
             boost::system::error_code ec = ecc;
             if (ec) {
                 DemuxStatistic::last_error(ec);
-                resp_(ec);
+                response(ec);
                 return;
             }
 
+            DemuxStatistic::open_wait_end();
             switch(open_state_) {
                 case closed:
                     open_state_ = media_open;
                     DemuxStatistic::open_beg_media();
+                    DemuxStatistic::open_phase_beg(phase_media, 0);
                     media_.async_open(
-                        boost::bind(&FFMpegDemuxer::handle_async_open, this, _1));
+                        strand().wrap(boost::bind(&FFMpegDemuxer::handle_async_open, this, _1)));
                     break;
                 case media_open:
                     media_.get_info(media_info_, ec);
                     media_.get_url(url_, ec);
+                    if (!ec) {
+                        acquire_buffer(10 * 1024 * 1024, media_info_.bitrate, ec);
+                    }
                     if (!ec) {
                         util::stream::UrlSource * source = 
                             util::stream::UrlSourceFactory::create(get_io_service(), media_.get_protocol(), ec);
@@ -165,11 +204,12 @@ namespace just
                             source->set_non_block(true, ec1);
                             source_ = new just::data::SingleSource(url_, *source);
                             source_->set_time_out(5000);
-                            buffer_ = new just::data::SingleBuffer(*source_, 10 * 1024 * 1024, 10240);
-                            insert_buffer(*buffer_);
+                            buffer_ = new just::data::SingleBuffer(*source_, granted_buffer(), 10240);
                             // TODO:
                             open_state_ = demuxer_open;
                             DemuxStatistic::open_beg_stream();
+                            // avformat_open_input probes and parses header in one call
+                            DemuxStatistic::open_phase_beg(phase_header, 0);
                             buffer_->pause_stream();
                             buffer_->seek(0, ec);
                             buffer_->pause_stream();
@@ -179,12 +219,11 @@ namespace just
                     if (!ec && avformat_open(ec)) {
                         open_state_ = opened;
                         on_open();
+                        DemuxStatistic::open_phase_end(buffer_->out_position());
                         open_end();
                         response(ec);
-                    } else if (ec == boost::asio::error::try_again && buffer_->out_position() < 1024 * 1024) {
-                        buffer_->async_prepare_some(0, 
-                            boost::bind(&FFMpegDemuxer::handle_async_open, this, _1));
                     } else {
+                        DemuxStatistic::open_phase_end(buffer_ ? buffer_->out_position() : 0);
                         open_end();
                         response(ec);
                     }
@@ -207,10 +246,7 @@ namespace just
             boost::uint64_t & time, 
             boost::system::error_code & ec)
         {
-            while (!peek_packets_.empty()) {
-                av_free_packet(peek_packets_.front());
-                peek_packets_.pop_front();
-            }
+            free_peek_packets();
             int64_t ts = time * (AV_TIME_BASE / 1000) + start_time_;
             int result = avformat_seek_file(avf_ctx_, -1, INT64_MIN, ts, INT64_MAX, 0);
             seek_time_ = time;
@@ -221,6 +257,8 @@ namespace just
             }
             if (&time != &seek_time_ && open_state_ == opened) {
                 DemuxStatistic::seek(!ec, time);
+                latency_mark(LatencyStat::seek);
+                track_seek();
             }
             if (ec) {
                 DemuxStatistic::last_error(ec);
@@ -244,6 +282,7 @@ namespace just
             boost::system::error_code & ec)
         {
             source_->pause();
+            buffer_active(false);
             DemuxStatistic::pause();
             ec.clear();
             return ec;
@@ -253,6 +292,7 @@ namespace just
             boost::system::error_code & ec)
         {
             buffer_->prepare_some(ec);
+            buffer_active(true);
             DemuxStatistic::resume();
             return ec;
         }
@@ -327,8 +367,10 @@ namespace just
             Sample & sample, 
             boost::system::error_code & ec)
         {
+            boost::uint64_t beg = latency_now();
             buffer_->prepare_some(ec);
             if (seek_pending_ && seek(seek_time_, ec)) {
+                latency_end(beg, ec);
                 return ec;
             }
             assert(!seek_pending_);
@@ -339,29 +381,37 @@ namespace just
             }
             sample.data.clear();
 
-            AVPacket * pkt = NULL;
+            just::data::MemoryLock * lock = NULL;
             if (!peek_packets_.empty()) {
-                pkt = peek_packets_.front();
+                lock = peek_packets_.front();
                 peek_packets_.pop_front();
                 ec.clear();
             } else {
-                pkt = (AVPacket *)av_malloc(sizeof(AVPacket));
-                av_init_packet(pkt);
-                int result = av_read_frame(avf_ctx_, pkt);
-                if (result < 0 || (pkt->flags & AV_PKT_FLAG_CORRUPT)) {
+                int result = 0;
+                while (true) {
+                    lock = alloc_packet();
+                    result = av_read_frame(avf_ctx_, (AVPacket *)lock->pointer);
+                    if (result < 0 || (((AVPacket *)lock->pointer)->flags & AV_PKT_FLAG_CORRUPT) == 0)
+                        break;
+                    // skip corrupt packets here, a would_block would never be followed by more data
+                    free_packet(lock);
+                }
+                if (result < 0) {
+                    free_packet(lock);
+                    // just_read waits for data, so only errors end up here
                     ec = buffer_->last_error();
-                    assert(ec);
-                    if (ec == boost::asio::error::eof)
+                    if (canceled_)
+                        ec = boost::asio::error::operation_aborted;
+                    else if (!ec || ec == boost::asio::error::eof)
                         ec = end_of_stream;
-                    if (!ec) {
-                        ec = boost::asio::error::would_block;
-                    }
+                    latency_end(beg, ec);
                     return ec;
                 } else {
                     ec.clear();
                 }
             }
 
+            AVPacket * pkt = (AVPacket *)lock->pointer;
             sample.itrack = pkt->stream_index;
             sample.flags = 0;
             if (pkt->flags & AV_PKT_FLAG_KEY) {
@@ -373,16 +423,26 @@ namespace just
             sample.size = pkt->size;
             sample.data.push_back(boost::asio::buffer(pkt->data, pkt->size));
             sample.stream_info = &streams_[sample.itrack];
-            just::data::MemoryLock * lock = (just::data::MemoryLock *)mem_lock_pool_.alloc();
-            new (lock) just::data::MemoryLock;
-            lock->pointer = pkt;
             sample.memory = lock;
 
             Demuxer::adjust_timestamp(sample);
+            track_sample(sample);
 
+            latency_end(beg, ec);
             return ec;
         }
 
+        just::data::MemoryLock * FFMpegDemuxer::alloc_packet()
+        {
+            PacketLock * lock = (PacketLock *)mem_lock_pool_.alloc();
+            new (lock) PacketLock;
+            av_init_packet(&lock->packet);
+            lock->packet.data = NULL;
+            lock->packet.size = 0;
+            lock->pointer = &lock->packet;
+            return lock;
+        }
+
         void FFMpegDemuxer::free_packet(
             just::data::MemoryLock * lock)
         {
@@ -393,10 +453,23 @@ namespace just
             }
             AVPacket * pkt = (AVPacket *)lock->pointer;
             av_free_packet(pkt);
-            av_free(pkt);
             mem_lock_pool_.free(lock);
         }
 
+        int FFMpegDemuxer::interrupt(
+            void * opaque)
+        {
+            return ((FFMpegDemuxer *)opaque)->canceled_ ? 1 : 0;
+        }
+
+        void FFMpegDemuxer::free_peek_packets()
+        {
+            while (!peek_packets_.empty()) {
+                free_packet(peek_packets_.front());
+                peek_packets_.pop_front();
+            }
+        }
+
         bool FFMpegDemuxer::free_sample(
             Sample & sample, 
             boost::system::error_code & ec)
@@ -413,19 +486,69 @@ namespace just
         bool FFMpegDemuxer::avformat_open(
             boost::system::error_code & ec)
         {
-            int result = avformat_open_input(&avf_ctx_, buffer_url(*buffer_).c_str(), NULL, NULL);
+            AVIOInterruptCB interrupt_cb = {&FFMpegDemuxer::interrupt, this};
+            avio_ctx_ = buffer_avio_open(*buffer_, io_buffer_size_, interrupt_cb);
+            avf_ctx_ = avformat_alloc_context();
+            if (avio_ctx_ == NULL || avf_ctx_ == NULL) {
+                avformat_free_context(avf_ctx_);
+                avf_ctx_ = NULL;
+                buffer_avio_close(avio_ctx_);
+                avio_ctx_ = NULL;
+                ec = boost::system::errc::make_error_code(boost::system::errc::not_enough_memory);
+                return false;
+            }
+            avf_ctx_->pb = avio_ctx_;
+            avf_ctx_->interrupt_callback = interrupt_cb;
+            avf_ctx_->probesize = probe_size_;
+            avf_ctx_->max_analyze_duration = (int)(analyze_duration_ * (AV_TIME_BASE / 1000));
+            int result = avformat_open_input(&avf_ctx_, "", NULL, NULL); // frees avf_ctx_ on failure
+            std::string cache_key;
+            std::string cache_file = info_cache_file(cache_key);
+            bool cached = result == 0 && !cache_file.empty() && load_info_cache(cache_file, cache_key);
             if (result == 0)
+                DemuxStatistic::open_phase_beg(phase_stream, buffer_->out_position());
+            if (result == 0 && !cached)
                 result = avformat_find_stream_info(avf_ctx_, NULL);
             if (result < 0) {
-                ec = boost::system::error_code(-result, boost::system::get_system_category());
+                if (avf_ctx_)
+                    avformat_close_input(&avf_ctx_);
+                buffer_avio_close(avio_ctx_);
+                avio_ctx_ = NULL;
+                if (canceled_)
+                    ec = boost::asio::error::operation_aborted;
+                else
+                    ec = boost::system::error_code(-result, boost::system::get_system_category());
                 return false;
             }
+            if (!cached) {
+                std::vector<boost::uint8_t> config_sources;
+                if (find_stream_infos(config_sources, ec) && !cache_file.empty()) {
+                    save_info_cache(cache_file, cache_key, config_sources);
+                }
+            }
+            start_time_ = streams_[0].start_time * AV_TIME_BASE / streams_[0].time_scale; // AV_TIME_BASE units
+            for (size_t i = 1; i < streams_.size(); ++i) {
+                if (streams_[i].start_time * AV_TIME_BASE < start_time_ * streams_[i].time_scale)
+                    start_time_ = streams_[i].start_time * AV_TIME_BASE / streams_[i].time_scale;
+            }
+            for (size_t i = 0; i < streams_.size(); ++i) {
+                if ((boost::int64_t)streams_[i].start_time >= 0)
+                    streams_[i].start_time = start_time_ * streams_[i].time_scale / AV_TIME_BASE;
+            }
+            return true;
+        }
+
+        bool FFMpegDemuxer::find_stream_infos(
+            std::vector<boost::uint8_t> & config_sources, 
+            boost::system::error_code & ec)
+        {
             media_info_.duration = avf_ctx_->duration / (AV_TIME_BASE / 1000);
             streams_.resize(avf_ctx_->nb_streams);
             boost::dynamic_bitset<> config_readys;
             boost::dynamic_bitset<> time_readys;
             config_readys.resize(avf_ctx_->nb_streams);
             time_readys.resize(avf_ctx_->nb_streams);
+            config_sources.assign(avf_ctx_->nb_streams, 0);
             for (unsigned int i = 0; i < avf_ctx_->nb_streams; ++i) {
                 StreamInfo & stream1 = streams_[i];
                 AVStream * stream2 = avf_ctx_->streams[i];
@@ -466,13 +589,20 @@ namespace just
                 stream1.format_data.assign(stream2->codec->extradata, stream2->codec->extradata + stream2->codec->extradata_size);
                 if (just::avformat::Format::finish_from_stream(stream1, "ffmpeg", stream2->codec->codec_id, ec)) {
                     config_readys.set(i);
+                    config_sources[i] = 1;
                 }
             }
-            while (time_readys.count() != time_readys.size() 
-                || config_readys.count() != config_readys.size()) {
-                    AVPacket * pkt = (AVPacket *)av_malloc(sizeof(AVPacket));
-                    av_init_packet(pkt);
-                    result = av_read_frame(avf_ctx_, pkt);
+            while ((time_readys.count() != time_readys.size() 
+                || config_readys.count() != config_readys.size())
+                && peek_packets_.size() < max_peek_packets_) {
+                    just::data::MemoryLock * lock = alloc_packet();
+                    AVPacket * pkt = (AVPacket *)lock->pointer;
+                    int result = av_read_frame(avf_ctx_, pkt);
+                    if (result < 0) {
+                        // leave missing infos as they are
+                        free_packet(lock);
+                        break;
+                    }
                     if (!time_readys.test(pkt->stream_index)) {
                         streams_[pkt->stream_index].start_time = pkt->dts;
                         time_readys.set(pkt->stream_index);
@@ -481,21 +611,248 @@ namespace just
                         streams_[pkt->stream_index].format_data.assign(pkt->data, pkt->data + pkt->size);
                         if (just::avcodec::Codec::static_finish_stream_info(streams_[pkt->stream_index], ec)) {
                             config_readys.set(pkt->stream_index);
+                            config_sources[pkt->stream_index] = 2;
                         }
                     }
-                    peek_packets_.push_back(pkt);
+                    peek_packets_.push_back(lock);
             }
-            start_time_ = streams_[0].start_time * AV_TIME_BASE / streams_[0].time_scale; // AV_TIME_BASE units
-            for (size_t i = 1; i < streams_.size(); ++i) {
-                if (streams_[i].start_time * AV_TIME_BASE < start_time_ * streams_[i].time_scale)
-                    start_time_ = streams_[i].start_time * AV_TIME_BASE / streams_[i].time_scale;
-            }
-            for (size_t i = 0; i < streams_.size(); ++i) {
-                if ((boost::int64_t)streams_[i].start_time >= 0)
-                    streams_[i].start_time = start_time_ * streams_[i].time_scale / AV_TIME_BASE;
+            if (time_readys.count() != time_readys.size() 
+                || config_readys.count() != config_readys.size()) {
+                LOG_WARN("[find_stream_infos] stream info not complete after " << peek_packets_.size() << " packets");
+                return false;
             }
             return true;
         }
 
+        /* stream info cache */
+
+        static boost::uint32_t const INFO_CACHE_MAGIC = 0x4349464a; // "JFIC"
+        static boost::uint32_t const INFO_CACHE_VERSION = 2;
+
+        template <typename T>
+        static void cache_put(
+            std::ostream & os, 
+            T const & t)
+        {
+            boost::uint64_t v = (boost::uint64_t)t;
+            os.write((char const *)&v, sizeof(v));
+        }
+
+        template <typename T>
+        static void cache_get(
+            std::istream & is, 
+            T & t)
+        {
+            boost::uint64_t v = 0;
+            is.read((char *)&v, sizeof(v));
+            t = (T)v;
+        }
+
+        static void cache_put_bytes(
+            std::ostream & os, 
+            std::vector<boost::uint8_t> const & bytes)
+        {
+            cache_put(os, bytes.size());
+            if (!bytes.empty())
+                os.write((char const *)&bytes[0], bytes.size());
+        }
+
+        static void cache_get_bytes(
+            std::istream & is, 
+            std::vector<boost::uint8_t> & bytes)
+        {
+            size_t size = 0;
+            cache_get(is, size);
+            if (!is || size > 16 * 1024 * 1024) {
+                is.setstate(std::ios::failbit);
+                return;
+            }
+            bytes.resize(size);
+            if (size)
+                is.read((char *)&bytes[0], size);
+        }
+
+        static void write_info_cache(
+            std::string const & file, 
+            std::string const & data)
+        {
+            // readers never see a partial file
+            std::string temp = file + "." + framework::string::format(boost::hash<std::string>()(data)) + ".tmp";
+            {
+                std::ofstream os(temp.c_str(), std::ios::binary | std::ios::trunc);
+                os.write(data.c_str(), data.size());
+                os.close();
+                if (!os) {
+                    LOG_WARN("[write_info_cache] failed to write " << temp);
+                    std::remove(temp.c_str());
+                    return;
+                }
+            }
+            if (std::rename(temp.c_str(), file.c_str()) != 0) {
+                // windows won't replace existing file
+                std::remove(file.c_str());
+                if (std::rename(temp.c_str(), file.c_str()) != 0) {
+                    LOG_WARN("[write_info_cache] failed to rename to " << file);
+                    std::remove(temp.c_str());
+                }
+            }
+        }
+
+        std::string FFMpegDemuxer::info_cache_file(
+            std::string & key) const
+        {
+            if (info_cache_path_.empty() || source_ == NULL)
+                return std::string();
+            boost::uint64_t size = source_->total_size();
+            if (size == 0 || size == just::data::invalid_size)
+                return std::string();
+            key = url_.to_string() + "#" + framework::string::format(size);
+            return info_cache_path_ + "/ffmpeg_" + framework::string::format(boost::hash<std::string>()(key)) + ".info";
+        }
+
+        bool FFMpegDemuxer::load_info_cache(
+            std::string const & file, 
+            std::string const & key)
+        {
+            std::ifstream is(file.c_str(), std::ios::binary);
+            if (!is)
+                return false;
+            boost::uint32_t magic = 0;
+            boost::uint32_t version = 0;
+            std::vector<boost::uint8_t> key2;
+            cache_get(is, magic);
+            cache_get(is, version);
+            cache_get_bytes(is, key2);
+            if (!is || magic != INFO_CACHE_MAGIC || version != INFO_CACHE_VERSION
+                || std::string(key2.begin(), key2.end()) != key) {
+                    return false;
+            }
+            boost::uint64_t duration = 0;
+            size_t count = 0;
+            cache_get(is, duration);
+            cache_get(is, count);
+            if (!is || count != avf_ctx_->nb_streams) {
+                return false;
+            }
+            std::vector<StreamInfo> streams(count);
+            std::vector<boost::uint8_t> config_sources(count);
+            for (size_t i = 0; i < count; ++i) {
+                StreamInfo & stream = streams[i];
+                boost::uint8_t config_source = 0;
+                boost::int32_t codec_id = 0;
+                cache_get(is, config_source);
+                config_sources[i] = config_source;
+                cache_get(is, codec_id);
+                cache_get(is, stream.type);
+                cache_get(is, stream.index);
+                cache_get(is, stream.time_scale);
+                cache_get(is, stream.bitrate);
+                cache_get(is, stream.start_time);
+                cache_get(is, stream.duration);
+                cache_get(is, stream.video_format.width);
+                cache_get(is, stream.video_format.height);
+                cache_get(is, stream.video_format.frame_rate_num);
+                cache_get(is, stream.video_format.frame_rate_den);
+                cache_get(is, stream.audio_format.channel_count);
+                cache_get(is, stream.audio_format.sample_size);
+                cache_get(is, stream.audio_format.sample_rate);
+                cache_get(is, stream.audio_format.block_align);
+                cache_get(is, stream.audio_format.sample_per_frame);
+                cache_get_bytes(is, stream.format_data);
+                AVCodecContext * codec = avf_ctx_->streams[i]->codec;
+                if (!is || codec_id != (boost::int32_t)codec->codec_id) {
+                    return false;
+                }
+                // codec specific parts are rebuilt from format_data
+                boost::system::error_code ec;
+                if (config_source == 1) {
+                    just::avformat::Format::finish_from_stream(stream, "ffmpeg", avf_ctx_->streams[i]->codec->codec_id, ec);
+                } else if (config_source == 2) {
+                    just::avcodec::Codec::static_finish_stream_info(stream, ec);
+                }
+                if (ec) {
+                    return false;
+                }
+            }
+            // avformat_find_stream_info is skipped, give codec contexts what it would find
+            for (size_t i = 0; i < count; ++i) {
+                StreamInfo const & stream = streams[i];
+                AVCodecContext * codec = avf_ctx_->streams[i]->codec;
+                if (stream.type == StreamType::VIDE) {
+                    codec->codec_type = AVMEDIA_TYPE_VIDEO;
+                    if (codec->width == 0) {
+                        codec->width = stream.video_format.width;
+                        codec->height = stream.video_format.height;
+                    }
+                    if (codec->time_base.num == 0 && stream.video_format.frame_rate_num) {
+                        codec->ticks_per_frame = 1;
+                        codec->time_base.num = stream.video_format.frame_rate_den;
+                        codec->time_base.den = stream.video_format.frame_rate_num;
+                    }
+                } else if (stream.type == StreamType::AUDI) {
+                    codec->codec_type = AVMEDIA_TYPE_AUDIO;
+                    if (codec->channels == 0)
+                        codec->channels = stream.audio_format.channel_count;
+                    if (codec->sample_rate == 0)
+                        codec->sample_rate = stream.audio_format.sample_rate;
+                    if (codec->bits_per_coded_sample == 0)
+                        codec->bits_per_coded_sample = stream.audio_format.sample_size;
+                    if (codec->block_align == 0)
+                        codec->block_align = stream.audio_format.block_align;
+                    if (codec->frame_size == 0)
+                        codec->frame_size = stream.audio_format.sample_per_frame;
+                }
+                if (codec->bit_rate == 0)
+                    codec->bit_rate = stream.bitrate;
+                if (codec->extradata_size == 0 && !stream.format_data.empty() && config_sources[i] == 1) {
+                    codec->extradata = (boost::uint8_t *)av_mallocz(stream.format_data.size() + FF_INPUT_BUFFER_PADDING_SIZE);
+                    if (codec->extradata) {
+                        memcpy(codec->extradata, &stream.format_data[0], stream.format_data.size());
+                        codec->extradata_size = (int)stream.format_data.size();
+                    }
+                }
+            }
+            media_info_.duration = duration;
+            streams_.swap(streams);
+            LOG_DEBUG("[load_info_cache] file: " << file);
+            return true;
+        }
+
+        void FFMpegDemuxer::save_info_cache(
+            std::string const & file, 
+            std::string const & key, 
+            std::vector<boost::uint8_t> const & config_sources) const
+        {
+            std::ostringstream os(std::ios::binary);
+            cache_put(os, INFO_CACHE_MAGIC);
+            cache_put(os, INFO_CACHE_VERSION);
+            cache_put_bytes(os, std::vector<boost::uint8_t>(key.begin(), key.end()));
+            cache_put(os, media_info_.duration);
+            cache_put(os, streams_.size());
+            for (size_t i = 0; i < streams_.size(); ++i) {
+                StreamInfo const & stream = streams_[i];
+                cache_put(os, config_sources[i]);
+                cache_put(os, (boost::int32_t)avf_ctx_->streams[i]->codec->codec_id);
+                cache_put(os, stream.type);
+                cache_put(os, stream.index);
+                cache_put(os, stream.time_scale);
+                cache_put(os, stream.bitrate);
+                cache_put(os, stream.start_time);
+                cache_put(os, stream.duration);
+                cache_put(os, stream.video_format.width);
+                cache_put(os, stream.video_format.height);
+                cache_put(os, stream.video_format.frame_rate_num);
+                cache_put(os, stream.video_format.frame_rate_den);
+                cache_put(os, stream.audio_format.channel_count);
+                cache_put(os, stream.audio_format.sample_size);
+                cache_put(os, stream.audio_format.sample_rate);
+                cache_put(os, stream.audio_format.block_align);
+                cache_put(os, stream.audio_format.sample_per_frame);
+                cache_put_bytes(os, stream.format_data);
+            }
+            // disk may be slow, don't hold io thread for it
+            boost::thread(boost::bind(write_info_cache, file, os.str())).detach();
+        }
+
     } // namespace demux
 } // namespace just
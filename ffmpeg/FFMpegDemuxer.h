@@ -12,7 +12,10 @@
 #include <framework/timer/Ticker.h>
 #include <framework/memory/SmallFixedPool.h>
 
+#include <boost/atomic.hpp>
+
 struct AVFormatContext;
+struct AVIOContext;
 struct AVPacket;
 
 namespace just
@@ -124,6 +127,26 @@ namespace just
             bool avformat_open(
                 boost::system::error_code & ec);
 
+            // return false if some stream info is still missing
+            bool find_stream_infos(
+                std::vector<boost::uint8_t> & config_sources, 
+                boost::system::error_code & ec);
+
+            // empty if cache is disabled or size is unknown
+            std::string info_cache_file(
+                std::string & key) const;
+
+            // also fills codec contexts, as avformat_find_stream_info would
+            bool load_info_cache(
+                std::string const & file, 
+                std::string const & key);
+
+            // written by a background thread, to temp file then renamed
+            void save_info_cache(
+                std::string const & file, 
+                std::string const & key, 
+                std::vector<boost::uint8_t> const & config_sources) const;
+
             bool is_open(
                 boost::system::error_code & ec) const;
 
@@ -133,16 +156,26 @@ namespace just
             void response(
                 boost::system::error_code const & ec);
 
+            // AVPacket lives in same pool block as its MemoryLock
+            just::data::MemoryLock * alloc_packet();
+
             void free_packet(
                 just::data::MemoryLock * lock);
 
+            void free_peek_packets();
+
+            // AVIOInterruptCB, breaks blocking reads after cancel
+            static int interrupt(
+                void * opaque);
+
         private:
             just::data::MediaBase & media_;
             just::data::SingleSource * source_;
             just::data::SingleBuffer * buffer_;
             framework::memory::SmallFixedPool mem_lock_pool_;
             AVFormatContext * avf_ctx_;
-            std::deque<AVPacket *> peek_packets_;
+            AVIOContext * avio_ctx_;
+            std::deque<just::data::MemoryLock *> peek_packets_;
             boost::uint64_t start_time_; // AV_TIME_BASE units
 
             framework::string::Url url_;
@@ -154,6 +187,15 @@ namespace just
 
             StateEnum open_state_;
             open_response_type resp_;
+            boost::atomic<bool> canceled_; // set from any thread, reset on open
+
+        private:
+            // config
+            boost::uint32_t io_buffer_size_; // 32K
+            boost::uint32_t probe_size_; // bytes, 5M
+            boost::uint32_t analyze_duration_; // milliseconds, 5 seconds
+            boost::uint32_t max_peek_packets_; // 200
+            std::string info_cache_path_; // directory, empty to disable
         };
 
     } // namespace demux
@@ -2,17 +2,18 @@
 
 #include "just/demux/Common.h"
 #include "just/demux/ffmpeg/FFMpegProto.h"
-#include "just/demux/ffmpeg/FFMpegURLProtocol.h"
 
 #include <just/data/single/SingleBuffer.h>
 #include <just/data/single/SingleSource.h>
 
-#include <framework/string/Parse.h>
-#include <framework/string/Format.h>
 #include <framework/logger/Logger.h>
 #include <framework/logger/StreamRecord.h>
 
-#include <boost/thread/mutex.hpp>
+extern "C" {
+#define UINT64_C(c)   c ## ULL
+#include <libavformat/avformat.h>
+#include <libavutil/time.h>
+}
 
 FRAMEWORK_LOGGER_DECLARE_MODULE_LEVEL("just.demux.FFMpegProto", framework::logger::Debug);
 
@@ -21,90 +22,54 @@ namespace just
     namespace demux
     {
 
-        static void register_protocol();
-
-        struct BufferSet
+        struct BufferAvio
         {
-            std::vector<just::data::SingleBuffer *> buffers_;
-            boost::mutex mutex_;
-            BufferSet()
-            {
-                register_protocol();
-            }
-
-            void insert(just::data::SingleBuffer & b)
-            {
-                boost::mutex::scoped_lock lc(mutex_);
-                buffers_.push_back(&b);
-            }
-
-            void remove(just::data::SingleBuffer & b)
-            {
-                boost::mutex::scoped_lock lc(mutex_);
-                buffers_.erase(std::find(buffers_.begin(), buffers_.end(), &b));
-            }
-
-            just::data::SingleBuffer * find(intptr_t p)
-            {
-                boost::mutex::scoped_lock lc(mutex_);
-                std::vector<just::data::SingleBuffer *>::const_iterator iter = 
-                    std::find(buffers_.begin(), buffers_.end(), (just::data::SingleBuffer *)p);
-                if (iter == buffers_.end()) {
-                    return NULL;
-                } else {
-                    return *iter;
-                }
-            }
+            just::data::SingleBuffer * buffer;
+            AVIOInterruptCB interrupt;
         };
 
-        static BufferSet & buffers()
+        static int just_read(
+            void * opaque, 
+            unsigned char * buf, 
+            int size)
         {
-            static BufferSet s_buffers;
-            return s_buffers;
-        }
-
-        static int just_open(
-            URLContext *h, 
-            const char *url, 
-            int flags)
-        {
-            intptr_t ptr = framework::string::parse<intptr_t>(url + 5);
-            h->priv_data = buffers().find(ptr);
-            if (h->priv_data) {
-                return 0;
-            }
-            return AVERROR(ENOENT);
-        }
-
-        static int just_read(
-            URLContext *h, 
-            unsigned char *buf, 
-            int size)
-        {
-            just::data::SingleBuffer * buffer = (just::data::SingleBuffer *)h->priv_data;
-            boost::system::error_code ec;
-            if (buffer->Buffer::in_avail() < (size_t)size)
-                buffer->prepare_some(ec);
-            size = buffer->sgetn(buf, size);
-            buffer->consume(size);
-            if (size) {
-                return size;
+            BufferAvio * avio = (BufferAvio *)opaque;
+            just::data::SingleBuffer * buffer = avio->buffer;
+            // same retry policy as ffurl_read, avio treats EAGAIN as eof
+            int fast_retries = 5;
+            while (true) {
+                if (avio->interrupt.callback && avio->interrupt.callback(avio->interrupt.opaque)) {
+                    return AVERROR_EXIT;
+                }
+                boost::system::error_code ec;
+                if (buffer->Buffer::in_avail() < (size_t)size)
+                    buffer->prepare_some(ec);
+                int len = buffer->sgetn(buf, size);
+                buffer->consume(len);
+                if (len) {
+                    return len;
+                }
+                if (ec != boost::asio::error::would_block) {
+                    return (!ec || ec == boost::asio::error::eof) ? AVERROR_EOF : AVERROR(ec.value());
+                }
+                if (fast_retries) {
+                    --fast_retries;
+                } else {
+                    av_usleep(1000);
+                }
             }
-            if (ec == boost::asio::error::would_block)
-                return AVERROR(EAGAIN);
-            else
-                return AVERROR(ec.value());
         }
 
         static int64_t just_seek(
-            URLContext *h, 
+            void * opaque, 
             int64_t pos, 
             int whence)
         {
-            just::data::SingleBuffer * buffer = (just::data::SingleBuffer *)h->priv_data;
+            just::data::SingleBuffer * buffer = ((BufferAvio *)opaque)->buffer;
             if (whence & AVSEEK_SIZE) {
                 return buffer->source().total_size();
             }
+            whence &= ~AVSEEK_FORCE;
             std::ios::seekdir const dirs[] = {std::ios::beg, std::ios::cur, std::ios::end};
             pos = buffer->pubseekoff(pos, dirs[whence], std::ios::in | std::ios::out);
             if (pos != -1) {
@@ -113,34 +78,35 @@ namespace just
             return AVERROR(EAGAIN);
         }
 
-        static URLProtocol ff_just_protocol = {
-            "just",            // name
-            just_open,         // url_open
-            NULL,               // url_open2
-            just_read,         // url_read
-            NULL,               // url_write
-            just_seek,         // url_seek
-            NULL,               // url_close
-        };
-
-        static void register_protocol()
-        {
-            ffurl_register_protocol(&ff_just_protocol, sizeof(URLProtocol));
-        }
-
-        void insert_buffer(just::data::SingleBuffer & b)
+        AVIOContext * buffer_avio_open(
+            just::data::SingleBuffer & b, 
+            size_t size, 
+            AVIOInterruptCB const & interrupt)
         {
-            buffers().insert(b);
-        }
-
-        void remove_buffer(just::data::SingleBuffer & b)
-        {
-            buffers().remove(b);
+            unsigned char * buf = (unsigned char *)av_malloc(size);
+            if (buf == NULL)
+                return NULL;
+            BufferAvio * opaque = new BufferAvio;
+            opaque->buffer = &b;
+            opaque->interrupt = interrupt;
+            AVIOContext * avio = avio_alloc_context(buf, (int)size, 0, opaque, just_read, NULL, just_seek);
+            if (avio == NULL) {
+                delete opaque;
+                av_free(buf);
+                return NULL;
+            }
+            LOG_DEBUG("[buffer_avio_open] buffer size: " << size);
+            return avio;
         }
 
-        std::string buffer_url(just::data::SingleBuffer & b)
+        void buffer_avio_close(
+            AVIOContext * avio)
         {
-            return "just:" + framework::string::format((intptr_t)&b);
+            if (avio) {
+                delete (BufferAvio *)avio->opaque;
+                av_freep(&avio->buffer);
+                av_free(avio);
+            }
         }
 
     } // namespace demux
@@ -3,7 +3,8 @@
 #ifndef _JUST_DEMUX_BASE_FFMPEG_FFMPEG_PROTO_H_
 #define _JUST_DEMUX_BASE_FFMPEG_FFMPEG_PROTO_H_
 
-struct URLProtocol;
+struct AVIOContext;
+struct AVIOInterruptCB;
 
 namespace just
 {
@@ -15,11 +16,15 @@ namespace just
     namespace demux
     {
 
-        void insert_buffer(just::data::SingleBuffer & b);
+        // io context reading directly from buffer, size is io buffer size
+        // reads wait for data, until interrupt callback returns non zero
+        AVIOContext * buffer_avio_open(
+            just::data::SingleBuffer & b, 
+            size_t size, 
+            AVIOInterruptCB const & interrupt);
 
-        void remove_buffer(just::data::SingleBuffer & b);
-
-        std::string buffer_url(just::data::SingleBuffer & b);
+        void buffer_avio_close(
+            AVIOContext * avio);
 
     } // namespace demux
 } // namespace just
@@ -0,0 +1,89 @@
+// FallbackDemuxer.cpp
+
+#include "just/demux/Common.h"
+#include "just/demux/ffmpeg/FallbackDemuxer.h"
+#include "just/demux/ffmpeg/FFMpegDemuxer.h"
+
+#include <framework/logger/Logger.h>
+#include <framework/logger/StreamRecord.h>
+
+#include <boost/bind.hpp>
+
+FRAMEWORK_LOGGER_DECLARE_MODULE_LEVEL("just.demux.FallbackDemuxer", framework::logger::Debug);
+
+namespace just
+{
+    namespace demux
+    {
+
+        FallbackDemuxer::FallbackDemuxer(
+            SingleDemuxer & single, 
+            just::data::MediaBase & media, 
+            SingleDemuxer::probe_check_type const & check, 
+            setup_type const & setup)
+            : CustomDemuxer(single)
+            , media_(media)
+            , check_(check)
+            , setup_(setup)
+            , rejected_(false)
+            , fallen_back_(false)
+        {
+            single.set_probe_check(
+                boost::bind(&FallbackDemuxer::probe_check, this, _1, _2));
+        }
+
+        FallbackDemuxer::~FallbackDemuxer()
+        {
+            if (attached())
+                delete &detach();
+        }
+
+        boost::system::error_code FallbackDemuxer::open (
+            boost::system::error_code & ec)
+        {
+            return Demuxer::open(ec);
+        }
+
+        void FallbackDemuxer::async_open(
+            open_response_type const & resp)
+        {
+            resp_ = resp;
+            CustomDemuxer::async_open(
+                strand().wrap(boost::bind(&FallbackDemuxer::handle_async_open, this, _1)));
+        }
+
+        bool FallbackDemuxer::probe_check(
+            std::string const & format, 
+            boost::uint32_t scope)
+        {
+            rejected_ = !check_(format, scope);
+            return !rejected_;
+        }
+
+        void FallbackDemuxer::handle_async_open(
+            boost::system::error_code const & ec)
+        {
+            if (ec && rejected_ && !fallen_back_) {
+                LOG_INFO("[handle_async_open] native rejected, fall back to ffmpeg");
+                fallen_back_ = true;
+                boost::system::error_code ec1;
+                DemuxerBase & single = detach();
+                single.close(ec1);
+                delete &single;
+                FFMpegDemuxer * ffmpeg = new FFMpegDemuxer(get_io_service(), media_);
+                setup_(*ffmpeg);
+                attach(*ffmpeg);
+                ffmpeg->async_open(
+                    strand().wrap(boost::bind(&FallbackDemuxer::handle_async_open, this, _1)));
+                return;
+            }
+            if (ec) {
+                DemuxStatistic::last_error(ec);
+            }
+            open_response_type resp;
+            resp.swap(resp_);
+            resp(ec);
+        }
+
+    } // namespace demux
+} // namespace just
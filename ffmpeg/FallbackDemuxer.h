@@ -0,0 +1,60 @@
+// FallbackDemuxer.h
+
+#ifndef _JUST_DEMUX_FFMPEG_FALLBACK_DEMUXER_H_
+#define _JUST_DEMUX_FFMPEG_FALLBACK_DEMUXER_H_
+
+#include "just/demux/base/CustomDemuxer.h"
+#include "just/demux/single/SingleDemuxer.h"
+
+namespace just
+{
+    namespace demux
+    {
+
+        // Opens with SingleDemuxer, which probes real bytes of the media,
+        // goes on with FFMpegDemuxer on same media when the probe check rejects native demuxer
+        class FallbackDemuxer
+            : public CustomDemuxer
+        {
+        public:
+            typedef boost::function<
+                void (DemuxerBase &)> setup_type;
+
+            // take ownership of single
+            // setup: applied to FFMpegDemuxer when created
+            FallbackDemuxer(
+                SingleDemuxer & single, 
+                just::data::MediaBase & media, 
+                SingleDemuxer::probe_check_type const & check, 
+                setup_type const & setup);
+
+            virtual ~FallbackDemuxer();
+
+        public:
+            virtual boost::system::error_code open (
+                boost::system::error_code & ec);
+
+            virtual void async_open(
+                open_response_type const & resp);
+
+        private:
+            bool probe_check(
+                std::string const & format, 
+                boost::uint32_t scope);
+
+            void handle_async_open(
+                boost::system::error_code const & ec);
+
+        private:
+            just::data::MediaBase & media_;
+            SingleDemuxer::probe_check_type check_;
+            setup_type setup_;
+            bool rejected_;
+            bool fallen_back_;
+            open_response_type resp_;
+        };
+
+    } // namespace demux
+} // namespace just
+
+#endif // _JUST_DEMUX_FFMPEG_FALLBACK_DEMUXER_H_
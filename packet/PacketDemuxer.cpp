@@ -16,6 +16,7 @@ using namespace just::avformat::error;
 
 #include <framework/logger/Logger.h>
 #include <framework/logger/StreamRecord.h>
+#include <framework/configure/Config.h>
 #include <framework/system/LogicError.h>
 
 #include <boost/bind.hpp>
@@ -34,10 +35,13 @@ namespace just
             : Demuxer(io_svc)
             , media_(media)
             , source_(NULL)
+            , sort_max_delay_(2000)
             , seek_time_(0)
             , seek_pending_(false)
             , open_state_(not_open)
         {
+            config_.register_module("Sort")
+                << CONFIG_PARAM_NAME_RDWR("max_delay", sort_max_delay_);
         }
 
         PacketDemuxer::~PacketDemuxer()
@@ -123,12 +127,14 @@ namespace just
                 return;
             }
 
+            DemuxStatistic::open_wait_end();
             switch(open_state_) {
                 case not_open:
                     open_state_ = media_open;
                     DemuxStatistic::open_beg_media();
+                    DemuxStatistic::open_phase_beg(phase_media, 0);
                     media_.async_open(
-                        boost::bind(&PacketDemuxer::handle_async_open, this, _1));
+                        strand().wrap(boost::bind(&PacketDemuxer::handle_async_open, this, _1)));
                     break;
                 case media_open:
                     media_.get_info(media_info_, ec);
@@ -141,6 +147,8 @@ namespace just
                         filters_.push_back(new SourceFilter(*source_));
                         open_state_ = demuxer_open;
                         DemuxStatistic::open_beg_stream();
+                        // packet media has no container header, only stream discovery
+                        DemuxStatistic::open_phase_beg(phase_stream, 0);
                     }
                 case demuxer_open:
                     source_->pause_stream();
@@ -150,17 +158,20 @@ namespace just
                             filters_.push_back(new TimestampFilter(timestamp()));
                         }
                         if (media_info_.flags & just::data::PacketMediaFlags::f_non_ordered) {
-                            filters_.push_back(new SortFilter(stream_infos_.size()));
+                            filters_.push_back(new SortFilter(stream_infos_.size(), sort_max_delay_));
                         }
                         on_open();
+                        DemuxStatistic::open_phase_end(source_->out_position());
                         DemuxStatistic::open_end();
                         source_->resume_stream();
                         response(ec);
                     } else if (ec == boost::asio::error::would_block) {
+                        DemuxStatistic::open_wait_beg();
                         source_->async_prepare(
-                            boost::bind(&PacketDemuxer::handle_async_open, this, _1));
+                            strand().wrap(boost::bind(&PacketDemuxer::handle_async_open, this, _1)));
                     } else {
                         open_state_ = open_finished;
+                        DemuxStatistic::open_phase_end(source_ ? source_->out_position() : 0);
                         DemuxStatistic::open_end();
                         response(ec);
                     }
@@ -242,6 +253,8 @@ namespace just
             }
             if (&time != &seek_time_ && open_state_ == open_finished) {
                 DemuxStatistic::seek(!ec, time);
+                latency_mark(LatencyStat::seek);
+                track_seek();
             }
             if (ec) {
                 DemuxStatistic::last_error(ec);
@@ -318,12 +331,61 @@ namespace just
             return !ec;
         }
 
+        size_t PacketDemuxer::get_samples(
+            Sample * samples, 
+            size_t max_count, 
+            size_t max_bytes, 
+            boost::system::error_code & ec)
+        {
+            boost::uint64_t beg = latency_now();
+            source_->prepare_some(ec);
+            if (seek_pending_ && seek(seek_time_, ec)) {
+                latency_end(beg, ec);
+                return 0;
+            }
+            assert(!seek_pending_);
+
+            size_t count = 0;
+            size_t bytes = 0;
+            while (count < max_count && bytes < max_bytes) {
+                free_sample(samples[count], ec);
+                get_sample2(samples[count], ec);
+                if (ec)
+                    break;
+                bytes += samples[count].size;
+                ++count;
+            }
+            if (ec == boost::asio::error::eof) {
+                ec = end_of_stream;
+            }
+            // ec is kept with count, caller sees why the pass stopped
+            if (count) {
+                DemuxStatistic::play_on(samples[count - 1].time);
+                latency_end(beg, boost::system::error_code());
+            } else {
+                if (ec == boost::asio::error::would_block) {
+                    DemuxStatistic::block_on();
+                }
+                last_error(ec);
+                latency_end(beg, ec);
+            }
+            return count;
+        }
+
+        void PacketDemuxer::async_prepare_data(
+            sample_response_type const & resp)
+        {
+            source_->async_prepare(boost::bind(resp, _1));
+        }
+
         boost::system::error_code PacketDemuxer::get_sample(
             Sample & sample, 
             boost::system::error_code & ec)
         {
+            boost::uint64_t beg = latency_now();
             source_->prepare_some(ec);
             if (seek_pending_ && seek(seek_time_, ec)) {
+                latency_end(beg, ec);
                 return ec;
             }
             assert(!seek_pending_);
@@ -342,6 +404,7 @@ namespace just
                 }
                 last_error(ec);
             }
+            latency_end(beg, ec);
             return ec;
         }
 
@@ -391,8 +454,10 @@ namespace just
                 sample = peek_samples_.front();
                 peek_samples_.pop_front();
                 ec.clear();
-                if ((sample.flags & sample.f_config) == 0)
+                if ((sample.flags & sample.f_config) == 0) {
+                    track_sample(sample);
                     return;
+                }
                 free_sample(sample, ec);
             }
             while (true) {
@@ -400,6 +465,9 @@ namespace just
                 if (ec || (sample.flags & sample.f_config) == 0)
                     break;
                 free_sample(sample, ec);
+            }
+            if (!ec) {
+                track_sample(sample);
             }
         }
 
@@ -92,6 +92,12 @@ namespace just
                 Sample & sample, 
                 boost::system::error_code & ec);
 
+            virtual size_t get_samples(
+                Sample * samples, 
+                size_t max_count, 
+                size_t max_bytes, 
+                boost::system::error_code & ec);
+
             virtual bool free_sample(
                 Sample & sample, 
                 boost::system::error_code & ec);
@@ -122,6 +128,9 @@ namespace just
             virtual boost::uint64_t get_end_time(
                 boost::system::error_code & ec);
 
+            virtual void async_prepare_data(
+                sample_response_type const & resp);
+
         protected:
             void add_filter(
                 Filter * filter);
@@ -165,6 +174,7 @@ namespace just
 
         private:
             framework::container::List<Filter> filters_;
+            boost::uint32_t sort_max_delay_; // config, ms
 
             boost::uint64_t seek_time_;
             bool seek_pending_;
@@ -8,6 +8,8 @@ using namespace just::avformat::error;
 #include <framework/logger/Logger.h>
 #include <framework/logger/StreamRecord.h>
 
+#include <algorithm>
+
 namespace just
 {
     namespace demux
@@ -16,23 +18,27 @@ namespace just
         FRAMEWORK_LOGGER_DECLARE_MODULE_LEVEL("just.demux.SortFilter", framework::logger::Debug);
 
         SortFilter::SortFilter(
-            boost::uint32_t stream_count)
-            : eof_(false)
+            boost::uint32_t stream_count, 
+            boost::uint32_t max_delay)
+            : max_delay_(max_delay)
+            , in_time_(0)
+            , eof_(false)
         {
             sample_queues_.resize(stream_count);
+            orders_.reserve(stream_count);
         }
 
         SortFilter::~SortFilter()
         {
         }
 
-        inline bool SortFilter::less_sample_queue::operator()(
-            SampleQueue * l, 
-            SampleQueue * r)
+        inline bool SortFilter::greater_sample_queue::operator()(
+            size_t l, 
+            size_t r) const
         {
-            Sample & sl = l->front();
-            Sample & sr = r->front();
-            return sl.time < sr.time || (sl.time == sr.time && sl.itrack < sr.itrack);
+            Sample & sl = queues_[l].front();
+            Sample & sr = queues_[r].front();
+            return sl.time > sr.time || (sl.time == sr.time && l > r);
         }
 
         bool SortFilter::get_sample(
@@ -44,18 +50,10 @@ namespace just
                 return false;
             }
 
-            while (!eof_ && orders_.size() < sample_queues_.size()) {
+            while (!eof_ && !ready()) {
                 if (Filter::get_sample(sample, ec)) {
                     LOG_TRACE("[get_sample] in itrack: " << sample.itrack << " time: " << sample.time << " dts: " << sample.dts);
-                    SampleQueue & queue = sample_queues_[sample.itrack];
-                    if (queue.empty()) {
-                        queue.push_back(sample);
-                        sample.data.clear();
-                        orders_.insert(&queue);
-                    } else {
-                        queue.push_back(sample);
-                        sample.data.clear();
-                    }
+                    push(sample);
                 } else if (ec == end_of_stream) {
                     eof_ = true;
                     if (orders_.empty()) {
@@ -67,14 +65,8 @@ namespace just
                 }
             }
 
-            SampleQueue & queue = **orders_.begin();
-            orders_.erase(orders_.begin());
-            sample = queue.front();
+            pop(sample);
             LOG_TRACE("[get_sample] out itrack: " << sample.itrack << " time: " << sample.time << " dts: " << sample.dts);
-            queue.pop_front();
-            if (!queue.empty()) {
-                orders_.insert(&queue);
-            }
 
             ec.clear();
             return true;
@@ -86,14 +78,73 @@ namespace just
         {
             for (size_t i = 0; i < sample_queues_.size(); ++i) {
                 SampleQueue & queue = sample_queues_[i];
-                for (size_t j = 0; j < queue.size(); ++j) {
-                    sample.append(queue[j]);
+                for (size_t j = 0; j < queue.count; ++j) {
+                    Sample & item = queue.items[(queue.head + j) % queue.items.size()];
+                    sample.append(item);
+                    item.data.clear();
                 }
-                queue.clear();
+                queue.head = 0;
+                queue.count = 0;
             }
             orders_.clear();
+            in_time_ = 0;
             return Filter::before_seek(sample, ec);
         }
 
+        void SortFilter::push(
+            Sample & sample)
+        {
+            SampleQueue & queue = sample_queues_[sample.itrack];
+            if (queue.count == queue.items.size()) {
+                std::vector<Sample> items(queue.count ? queue.count * 2 : 16);
+                for (size_t i = 0; i < queue.count; ++i) {
+                    move_sample(items[i], queue.items[(queue.head + i) % queue.count]);
+                }
+                queue.items.swap(items);
+                queue.head = 0;
+            }
+            move_sample(queue.items[(queue.head + queue.count) % queue.items.size()], sample);
+            if (queue.count++ == 0) {
+                orders_.push_back(sample.itrack);
+                std::push_heap(orders_.begin(), orders_.end(), greater_sample_queue(sample_queues_));
+            }
+            if (sample.time > in_time_) {
+                in_time_ = sample.time;
+            }
+        }
+
+        void SortFilter::pop(
+            Sample & sample)
+        {
+            std::pop_heap(orders_.begin(), orders_.end(), greater_sample_queue(sample_queues_));
+            SampleQueue & queue = sample_queues_[orders_.back()];
+            move_sample(sample, queue.front());
+            queue.head = (queue.head + 1) % queue.items.size();
+            if (--queue.count == 0) {
+                orders_.pop_back();
+            } else {
+                std::push_heap(orders_.begin(), orders_.end(), greater_sample_queue(sample_queues_));
+            }
+        }
+
+        void SortFilter::move_sample(
+            Sample & to, 
+            Sample & from)
+        {
+            spare_.data.swap(from.data);
+            to = from;
+            to.data.swap(spare_.data);
+        }
+
+        bool SortFilter::ready()
+        {
+            if (orders_.size() == sample_queues_.size()) {
+                return true;
+            }
+            // some track silent, don't hold others longer than max delay
+            return max_delay_ && !orders_.empty() 
+                && in_time_ >= sample_queues_[orders_.front()].front().time + max_delay_;
+        }
+
     } // namespace demux
 } // namespace just
@@ -14,8 +14,10 @@ namespace just
             : public Filter
         {
         public:
+            // max_delay: ms a sample may wait for silent tracks, 0 for until end of stream
             SortFilter(
-                boost::uint32_t stream_count);
+                boost::uint32_t stream_count, 
+                boost::uint32_t max_delay);
 
             ~SortFilter();
 
@@ -29,17 +31,61 @@ namespace just
                 boost::system::error_code & ec);
 
         private:
-            typedef std::deque<Sample> SampleQueue;
-            struct less_sample_queue
+            // ring of samples, grows but never shrinks
+            struct SampleQueue
             {
+                SampleQueue()
+                    : head(0)
+                    , count(0)
+                {
+                }
+
+                Sample & front()
+                {
+                    return items[head];
+                }
+
+                std::vector<Sample> items;
+                size_t head;
+                size_t count;
+            };
+
+            // min heap by front sample time, then by track
+            struct greater_sample_queue
+            {
+                greater_sample_queue(
+                    std::vector<SampleQueue> & queues)
+                    : queues_(queues)
+                {
+                }
+
                 bool operator()(
-                    SampleQueue * l, 
-                    SampleQueue * r);
+                    size_t l, 
+                    size_t r) const;
+
+                std::vector<SampleQueue> & queues_;
             };
 
+        private:
+            void push(
+                Sample & sample);
+
+            void pop(
+                Sample & sample);
+
+            // fields copied, buffer list swapped
+            void move_sample(
+                Sample & to, 
+                Sample & from);
+
+            bool ready();
+
         private:
             std::vector<SampleQueue> sample_queues_;
-            std::set<SampleQueue *, less_sample_queue> orders_; 
+            std::vector<size_t> orders_; // heap of non-empty queues
+            boost::uint32_t max_delay_;
+            boost::uint64_t in_time_; // latest time in
+            Sample spare_; // empty buffer list for move_sample
             bool eof_;
         };
 
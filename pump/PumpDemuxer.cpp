@@ -0,0 +1,338 @@
+// PumpDemuxer.cpp
+
+#include "just/demux/Common.h"
+#include "just/demux/pump/PumpDemuxer.h"
+#include "just/demux/base/DemuxError.h"
+
+#include <framework/logger/Logger.h>
+#include <framework/logger/StreamRecord.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+FRAMEWORK_LOGGER_DECLARE_MODULE_LEVEL("just.demux.PumpDemuxer", framework::logger::Debug);
+
+namespace just
+{
+    namespace demux
+    {
+
+        PumpDemuxer::PumpDemuxer(
+            DemuxerBase & upstream)
+            : CustomDemuxer(upstream)
+            , ring_size_(64)
+            , idle_wait_(10)
+            , upstream_(upstream)
+            , thread_(NULL)
+            , stopped_(true)
+            , failed_(false)
+        {
+            config_.register_module("Pump")
+                << CONFIG_PARAM_NAME_RDWR("ring_size", ring_size_)
+                << CONFIG_PARAM_NAME_RDWR("idle_wait", idle_wait_);
+        }
+
+        PumpDemuxer::~PumpDemuxer()
+        {
+            stop(true);
+            drain();
+            delete &detach();
+        }
+
+        boost::system::error_code PumpDemuxer::open (
+            boost::system::error_code & ec)
+        {
+            return Demuxer::open(ec);
+        }
+
+        void PumpDemuxer::async_open(
+            open_response_type const & resp)
+        {
+            open_resp_ = resp;
+            DemuxStatistic::open_beg_stream();
+            upstream_.async_open(
+                boost::bind(&PumpDemuxer::handle_async_open, this, _1));
+        }
+
+        void PumpDemuxer::handle_async_open(
+            boost::system::error_code const & ec)
+        {
+            if (!ec) {
+                start();
+            } else {
+                DemuxStatistic::last_error(ec);
+            }
+            open_end();
+            open_response_type resp;
+            resp.swap(open_resp_);
+            resp(ec);
+        }
+
+        boost::system::error_code PumpDemuxer::close(
+            boost::system::error_code & ec)
+        {
+            stop(true);
+            drain();
+            notify(boost::asio::error::operation_aborted);
+            DemuxStatistic::close();
+            boost::mutex::scoped_lock lock(mutex_);
+            return upstream_.close(ec);
+        }
+
+        bool PumpDemuxer::get_stream_status(
+            StreamStatus & info, 
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            return upstream_.get_stream_status(info, ec);
+        }
+
+        bool PumpDemuxer::get_data_stat(
+            DataStat & stat, 
+            boost::system::error_code & ec) const
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            return upstream_.get_data_stat(stat, ec);
+        }
+
+        bool PumpDemuxer::get_track_stat(
+            std::vector<TrackStat> & stats, 
+            boost::system::error_code & ec) const
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            return upstream_.get_track_stat(stats, ec);
+        }
+
+        boost::system::error_code PumpDemuxer::reset(
+            boost::system::error_code & ec)
+        {
+            boost::uint64_t time = 0;
+            return seek(time, ec);
+        }
+
+        boost::system::error_code PumpDemuxer::seek(
+            boost::uint64_t & time, 
+            boost::system::error_code & ec)
+        {
+            // samples before seek are dropped with the rings
+            bool running = thread_ != NULL;
+            stop();
+            drain();
+            {
+                boost::mutex::scoped_lock lock(mutex_);
+                upstream_.seek(time, ec);
+            }
+            if (ec == boost::asio::error::would_block) {
+                // upstream finishes seek in its get_sample
+                ec.clear();
+            }
+            DemuxStatistic::seek(!ec, time);
+            latency_mark(LatencyStat::seek);
+            if (running) {
+                start();
+            }
+            return ec;
+        }
+
+        boost::system::error_code PumpDemuxer::pause(
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            upstream_.pause(ec);
+            DemuxStatistic::pause();
+            return ec;
+        }
+
+        boost::system::error_code PumpDemuxer::resume(
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            upstream_.resume(ec);
+            DemuxStatistic::resume();
+            return ec;
+        }
+
+        bool PumpDemuxer::fill_data(
+            boost::system::error_code & ec)
+        {
+            if (!samples_.empty()) {
+                ec.clear();
+            } else if (failed_.load(boost::memory_order_acquire)) {
+                ec = pump_ec_;
+            } else {
+                ec = boost::asio::error::would_block;
+            }
+            return !ec;
+        }
+
+        boost::system::error_code PumpDemuxer::get_sample(
+            Sample & sample, 
+            boost::system::error_code & ec)
+        {
+            boost::uint64_t beg = latency_now();
+            if (sample.memory) {
+                free_sample(sample, ec);
+            }
+            if (thread_ == NULL) {
+                ec = error::not_open;
+                return ec;
+            }
+            if (samples_.pop(sample)) {
+                ec.clear();
+            } else if (!failed_.load(boost::memory_order_acquire)) {
+                ec = boost::asio::error::would_block;
+            } else if (samples_.pop(sample)) {
+                // pushed just before failure published
+                ec.clear();
+            } else {
+                ec = pump_ec_;
+            }
+            if (!ec) {
+                DemuxStatistic::play_on(sample.time);
+            } else if (ec == boost::asio::error::would_block) {
+                DemuxStatistic::block_on();
+            } else {
+                DemuxStatistic::last_error(ec);
+            }
+            latency_end(beg, ec);
+            return ec;
+        }
+
+        size_t PumpDemuxer::get_samples(
+            Sample * samples, 
+            size_t max_count, 
+            size_t max_bytes, 
+            boost::system::error_code & ec)
+        {
+            // samples are already out of upstream, nothing to save by batching there
+            return DemuxerBase::get_samples(samples, max_count, max_bytes, ec);
+        }
+
+        bool PumpDemuxer::free_sample(
+            Sample & sample, 
+            boost::system::error_code & ec)
+        {
+            ec.clear();
+            if (sample.memory == NULL)
+                return true;
+            if (thread_ == NULL) {
+                boost::mutex::scoped_lock lock(mutex_);
+                return upstream_.free_sample(sample, ec);
+            }
+            // frees_ is twice the size of samples_, full only briefly
+            while (!frees_.push(sample)) {
+                boost::this_thread::yield();
+            }
+            sample.memory = NULL;
+            sample.data.clear();
+            return true;
+        }
+
+        void PumpDemuxer::async_prepare_data(
+            sample_response_type const & resp)
+        {
+            boost::mutex::scoped_lock lock(resp_mutex_);
+            if (!samples_.empty() || failed_.load(boost::memory_order_acquire)) {
+                get_io_service().post(boost::bind(resp, boost::system::error_code()));
+            } else {
+                prepare_resp_ = resp;
+            }
+        }
+
+        void PumpDemuxer::start()
+        {
+            samples_.reset(ring_size_);
+            frees_.reset(ring_size_ * 2);
+            pump_ec_.clear();
+            failed_.store(false);
+            stopped_.store(false);
+            thread_ = new boost::thread(boost::bind(&PumpDemuxer::pump, this));
+        }
+
+        void PumpDemuxer::stop(
+            bool cancel)
+        {
+            if (thread_ == NULL)
+                return;
+            stopped_.store(true);
+            if (cancel) {
+                // without lock, mutex_ is held by pump thread while it blocks in get_sample
+                boost::system::error_code ec;
+                upstream_.cancel(ec);
+            }
+            thread_->join();
+            delete thread_;
+            thread_ = NULL;
+        }
+
+        void PumpDemuxer::pump()
+        {
+            LOG_DEBUG("[pump] start");
+            Sample sample;
+            Sample freed;
+            boost::system::error_code ec;
+            while (!stopped_.load()) {
+                bool idle = false;
+                bool pushed = false;
+                {
+                    boost::mutex::scoped_lock lock(mutex_);
+                    while (frees_.pop(freed)) {
+                        upstream_.free_sample(freed, ec);
+                    }
+                    if (failed_.load(boost::memory_order_relaxed) || samples_.full()) {
+                        idle = true;
+                    } else {
+                        upstream_.get_sample(sample, ec);
+                        if (!ec) {
+                            // memory lock now owned by ring
+                            samples_.push(sample);
+                            sample.memory = NULL;
+                            pushed = true;
+                        } else if (ec == boost::asio::error::would_block) {
+                            idle = true;
+                        } else {
+                            LOG_DEBUG("[pump] stop on ec: " << ec.message());
+                            pump_ec_ = ec;
+                            failed_.store(true, boost::memory_order_release);
+                            pushed = true;
+                        }
+                    }
+                }
+                if (pushed) {
+                    notify(boost::system::error_code());
+                }
+                if (idle) {
+                    boost::this_thread::sleep(boost::posix_time::milliseconds(idle_wait_));
+                }
+            }
+            LOG_DEBUG("[pump] stop");
+        }
+
+        void PumpDemuxer::drain()
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            boost::system::error_code ec;
+            Sample sample;
+            while (samples_.pop(sample)) {
+                upstream_.free_sample(sample, ec);
+            }
+            while (frees_.pop(sample)) {
+                upstream_.free_sample(sample, ec);
+            }
+        }
+
+        void PumpDemuxer::notify(
+            boost::system::error_code const & ec)
+        {
+            sample_response_type resp;
+            {
+                boost::mutex::scoped_lock lock(resp_mutex_);
+                resp.swap(prepare_resp_);
+            }
+            if (!resp.empty()) {
+                get_io_service().post(boost::bind(resp, ec));
+            }
+        }
+
+    } // namespace demux
+} // namespace just
@@ -0,0 +1,133 @@
+// PumpDemuxer.h
+
+#ifndef _JUST_DEMUX_PUMP_PUMP_DEMUXER_H_
+#define _JUST_DEMUX_PUMP_PUMP_DEMUXER_H_
+
+#include "just/demux/base/CustomDemuxer.h"
+#include "just/demux/pump/SampleRing.h"
+
+#include <boost/thread/mutex.hpp>
+
+namespace boost
+{
+    class thread;
+}
+
+namespace just
+{
+    namespace demux
+    {
+
+        // Runs get_sample of the upstream demuxer on its own thread
+        // samples are handed over with their memory locks, freed ones go back to the pump thread
+        class PumpDemuxer
+            : public CustomDemuxer
+        {
+        public:
+            // take ownership of upstream
+            PumpDemuxer(
+                DemuxerBase & upstream);
+
+            virtual ~PumpDemuxer();
+
+        public:
+            virtual boost::system::error_code open (
+                boost::system::error_code & ec);
+
+            virtual void async_open(
+                open_response_type const & resp);
+
+            virtual boost::system::error_code close(
+                boost::system::error_code & ec);
+
+        public:
+            virtual bool get_stream_status(
+                StreamStatus & info, 
+                boost::system::error_code & ec);
+
+            virtual bool get_data_stat(
+                DataStat & stat, 
+                boost::system::error_code & ec) const;
+
+            virtual bool get_track_stat(
+                std::vector<TrackStat> & stats, 
+                boost::system::error_code & ec) const;
+
+        public:
+            virtual boost::system::error_code reset(
+                boost::system::error_code & ec);
+
+            virtual boost::system::error_code seek(
+                boost::uint64_t & time, 
+                boost::system::error_code & ec);
+
+            virtual boost::system::error_code pause(
+                boost::system::error_code & ec);
+
+            virtual boost::system::error_code resume(
+                boost::system::error_code & ec);
+
+            virtual bool fill_data(
+                boost::system::error_code & ec);
+
+        public:
+            // never blocks, would_block if ring is empty
+            virtual boost::system::error_code get_sample(
+                Sample & sample, 
+                boost::system::error_code & ec);
+
+            virtual size_t get_samples(
+                Sample * samples, 
+                size_t max_count, 
+                size_t max_bytes, 
+                boost::system::error_code & ec);
+
+            virtual bool free_sample(
+                Sample & sample, 
+                boost::system::error_code & ec);
+
+        protected:
+            virtual void async_prepare_data(
+                sample_response_type const & resp);
+
+        private:
+            void handle_async_open(
+                boost::system::error_code const & ec);
+
+            void start();
+
+            // cancel upstream first if it is not used any more, pump thread may be blocked in it
+            void stop(
+                bool cancel = false);
+
+            void pump();
+
+            // give back samples in both rings, pump thread stopped
+            void drain();
+
+            void notify(
+                boost::system::error_code const & ec);
+
+        private:
+            // config
+            boost::uint32_t ring_size_; // 64 samples
+            boost::uint32_t idle_wait_; // ms, when upstream would block or ring is full
+
+        private:
+            DemuxerBase & upstream_;
+            mutable boost::mutex mutex_; // guard upstream between pump thread and consumer
+            boost::thread * thread_;
+            boost::atomic<bool> stopped_;
+            boost::atomic<bool> failed_; // pump_ec_ is set, published after last pushed sample
+            boost::system::error_code pump_ec_;
+            SampleRing<Sample> samples_; // pump thread -> consumer
+            SampleRing<Sample> frees_; // consumer -> pump thread
+            boost::mutex resp_mutex_;
+            sample_response_type prepare_resp_;
+            open_response_type open_resp_;
+        };
+
+    } // namespace demux
+} // namespace just
+
+#endif // _JUST_DEMUX_PUMP_PUMP_DEMUXER_H_
@@ -0,0 +1,104 @@
+// SampleRing.h
+
+#ifndef _JUST_DEMUX_PUMP_SAMPLE_RING_H_
+#define _JUST_DEMUX_PUMP_SAMPLE_RING_H_
+
+#include <boost/atomic.hpp>
+
+namespace just
+{
+    namespace demux
+    {
+
+        // Bounded ring with one producer thread and one consumer thread, no lock
+        // items are moved in and out by swapping their data member (buffer list), not copied
+        template <typename T>
+        class SampleRing
+        {
+        public:
+            SampleRing(
+                size_t capacity = 0)
+                : items_(capacity + 1)
+                , head_(0)
+                , tail_(0)
+            {
+            }
+
+        public:
+            // only when both sides are stopped
+            void reset(
+                size_t capacity)
+            {
+                items_.clear();
+                items_.resize(capacity + 1);
+                head_.store(0);
+                tail_.store(0);
+            }
+
+            size_t capacity() const
+            {
+                return items_.size() - 1;
+            }
+
+        public:
+            // producer side, t.data is left empty
+            bool push(
+                T & t)
+            {
+                size_t tail = tail_.load(boost::memory_order_relaxed);
+                size_t next = (tail + 1) % items_.size();
+                if (next == head_.load(boost::memory_order_acquire))
+                    return false;
+                move(items_[tail], t, push_spare_);
+                tail_.store(next, boost::memory_order_release);
+                return true;
+            }
+
+            bool full() const
+            {
+                size_t next = (tail_.load(boost::memory_order_relaxed) + 1) % items_.size();
+                return next == head_.load(boost::memory_order_acquire);
+            }
+
+        public:
+            // consumer side
+            bool pop(
+                T & t)
+            {
+                size_t head = head_.load(boost::memory_order_relaxed);
+                if (head == tail_.load(boost::memory_order_acquire))
+                    return false;
+                move(t, items_[head], pop_spare_);
+                head_.store((head + 1) % items_.size(), boost::memory_order_release);
+                return true;
+            }
+
+            bool empty() const
+            {
+                return head_.load(boost::memory_order_acquire) == tail_.load(boost::memory_order_acquire);
+            }
+
+        private:
+            // like SortFilter::move_sample, spare is per side, so no sharing between threads
+            static void move(
+                T & to, 
+                T & from, 
+                T & spare)
+            {
+                spare.data.swap(from.data);
+                to = from;
+                to.data.swap(spare.data);
+            }
+
+        private:
+            std::vector<T> items_;
+            T push_spare_; // empty buffer lists, keep their capacity
+            T pop_spare_;
+            boost::atomic<size_t> head_;
+            boost::atomic<size_t> tail_;
+        };
+
+    } // namespace demux
+} // namespace just
+
+#endif // _JUST_DEMUX_PUMP_SAMPLE_RING_H_
@@ -0,0 +1,136 @@
+// AbrController.cpp
+
+#include "just/demux/Common.h"
+#include "just/demux/segment/AbrController.h"
+
+#include <framework/logger/Logger.h>
+#include <framework/logger/StreamRecord.h>
+
+FRAMEWORK_LOGGER_DECLARE_MODULE_LEVEL("just.demux.AbrController", framework::logger::Debug);
+
+namespace just
+{
+    namespace demux
+    {
+
+        AbrController::AbrController(
+            framework::configure::Config & config)
+            : safety_(80)
+            , low_buffer_(5000)
+            , high_buffer_(15000)
+            , min_interval_(10000)
+            , sample_interval_(500)
+            , current_(0)
+            , throughput_(0)
+            , last_bytes_(0)
+            , last_time_(0)
+            , switch_time_(0)
+        {
+            config.register_module("Abr")
+                << CONFIG_PARAM_NAME_RDWR("safety", safety_)
+                << CONFIG_PARAM_NAME_RDWR("low_buffer", low_buffer_)
+                << CONFIG_PARAM_NAME_RDWR("high_buffer", high_buffer_)
+                << CONFIG_PARAM_NAME_RDWR("min_interval", min_interval_)
+                << CONFIG_PARAM_NAME_RDWR("sample_interval", sample_interval_);
+        }
+
+        void AbrController::add_rendition(
+            boost::uint32_t bitrate)
+        {
+            bitrates_.push_back(bitrate);
+        }
+
+        void AbrController::reset()
+        {
+            bitrates_.clear();
+            current_ = 0;
+            throughput_ = 0;
+            last_bytes_ = 0;
+            last_time_ = (boost::uint32_t)clock_.elapse();
+            switch_time_ = last_time_;
+        }
+
+        void AbrController::seek(
+            size_t current)
+        {
+            if (current < bitrates_.size())
+                current_ = current;
+            // next update restarts sampling from new buffer position
+            last_bytes_ = boost::uint64_t(-1);
+        }
+
+        void AbrController::update(
+            boost::uint64_t bytes)
+        {
+            boost::uint32_t now = (boost::uint32_t)clock_.elapse();
+            if (bytes < last_bytes_) {
+                // buffer restarted, after seek
+                last_bytes_ = bytes;
+                last_time_ = now;
+                return;
+            }
+            boost::uint32_t elapse = now - last_time_;
+            if (elapse < sample_interval_)
+                return;
+            boost::uint64_t delta = bytes - last_bytes_;
+            last_bytes_ = bytes;
+            last_time_ = now;
+            // no bytes means download paused on full buffer, not a slow link
+            if (delta == 0)
+                return;
+            boost::uint32_t rate = (boost::uint32_t)(delta * 8000 / elapse);
+            throughput_ = throughput_ ? (throughput_ * 7 + rate) / 8 : rate;
+        }
+
+        size_t AbrController::select(
+            boost::uint32_t buffer_time)
+        {
+            if (bitrates_.size() < 2 || throughput_ == 0)
+                return current_;
+            boost::uint64_t budget = (boost::uint64_t)throughput_ * safety_ / 100;
+            size_t best = bitrates_.size();
+            for (size_t i = 0; i < bitrates_.size(); ++i) {
+                if (bitrates_[i] <= budget
+                    && (best == bitrates_.size() || bitrates_[i] > bitrates_[best])) {
+                        best = i;
+                }
+            }
+            size_t lowest = 0;
+            for (size_t i = 1; i < bitrates_.size(); ++i) {
+                if (bitrates_[i] < bitrates_[lowest])
+                    lowest = i;
+            }
+            if (best == bitrates_.size())
+                best = lowest;
+            boost::uint32_t now = (boost::uint32_t)clock_.elapse();
+            size_t next = current_;
+            if (bitrates_[best] < bitrates_[current_]) {
+                next = best;
+            } else if (bitrates_[best] > bitrates_[current_]
+                && buffer_time >= high_buffer_
+                && now - switch_time_ >= min_interval_) {
+                    // one level up
+                    next = best;
+                    for (size_t i = 0; i < bitrates_.size(); ++i) {
+                        if (bitrates_[i] > bitrates_[current_] && bitrates_[i] < bitrates_[next])
+                            next = i;
+                    }
+            } else if (buffer_time < low_buffer_ && current_ != lowest) {
+                // throughput estimate lags behind a draining buffer
+                for (size_t i = 0; i < bitrates_.size(); ++i) {
+                    if (bitrates_[i] < bitrates_[current_] && (next == current_ || bitrates_[i] > bitrates_[next]))
+                        next = i;
+                }
+            }
+            if (next != current_) {
+                LOG_INFO("[select] rendition " << current_ << " -> " << next
+                    << ", bitrate: " << bitrates_[next] << ", throughput: " << throughput_
+                    << ", buffer: " << buffer_time);
+                current_ = next;
+                switch_time_ = now;
+            }
+            return current_;
+        }
+
+    } // namespace demux
+} // namespace just
@@ -0,0 +1,79 @@
+// AbrController.h
+
+#ifndef _JUST_DEMUX_SEGMENT_ABR_CONTROLLER_H_
+#define _JUST_DEMUX_SEGMENT_ABR_CONTROLLER_H_
+
+#include <framework/configure/Config.h>
+#include <framework/timer/TimeCounter.h>
+
+namespace just
+{
+    namespace demux
+    {
+
+        // Chooses rendition at segment boundaries from measured throughput and buffered time
+        // goes down at once when link can't keep up, goes up one level at a time with full buffer
+        class AbrController
+        {
+        public:
+            AbrController(
+                framework::configure::Config & config);
+
+        public:
+            // bits per second, index in order of adding
+            void add_rendition(
+                boost::uint32_t bitrate);
+
+            size_t rendition_count() const
+            {
+                return bitrates_.size();
+            }
+
+            size_t current() const
+            {
+                return current_;
+            }
+
+            // forget renditions and measures, on open
+            void reset();
+
+            // position moved to rendition, keep throughput but restart sampling
+            void seek(
+                size_t current);
+
+        public:
+            // bytes downloaded so far
+            void update(
+                boost::uint64_t bytes);
+
+            // buffer_time: ms of media buffered ahead of play position
+            size_t select(
+                boost::uint32_t buffer_time);
+
+            boost::uint32_t throughput() const
+            {
+                return throughput_;
+            }
+
+        private:
+            // config
+            boost::uint32_t safety_; // percent of throughput usable by bitrate
+            boost::uint32_t low_buffer_; // ms, below it never goes up, and goes down
+            boost::uint32_t high_buffer_; // ms, above it may go up
+            boost::uint32_t min_interval_; // ms between switches up
+            boost::uint32_t sample_interval_; // ms between throughput samples
+
+        private:
+            std::vector<boost::uint32_t> bitrates_;
+            size_t current_;
+            boost::uint32_t throughput_; // bps, moving average
+            boost::uint64_t last_bytes_;
+            boost::uint32_t last_time_;
+            boost::uint32_t switch_time_;
+            framework::timer::TimeCounter clock_;
+        };
+
+    } // namespace demux
+} // namespace just
+
+#endif // _JUST_DEMUX_SEGMENT_ABR_CONTROLLER_H_
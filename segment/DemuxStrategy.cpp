@@ -40,11 +40,49 @@ namespace just
             , insert_size_(0)
             , insert_delta_(0)
             , insert_time_(0)
+            , time_index_end_(0)
+            , time_index_count_(0)
+            , time_index_disabled_(false)
+            , rendition_switch_(size_t(-1))
         {
         }
 
         DemuxStrategy::~DemuxStrategy()
         {
+            for (size_t i = 0; i < renditions_.size(); ++i) {
+                delete renditions_[i];
+            }
+        }
+
+        void DemuxStrategy::add_rendition(
+            DemuxStrategy * strategy)
+        {
+            renditions_.push_back(strategy);
+        }
+
+        void DemuxStrategy::switch_rendition(
+            size_t index)
+        {
+            assert(index <= renditions_.size());
+            rendition_switch_ = index;
+        }
+
+        size_t DemuxStrategy::rendition_of(
+            just::data::SegmentPosition const & pos) const
+        {
+            if (!pos.item_context)
+                return 0;
+            DemuxStrategy const * strategy = ((SourceTreeItem const *)pos.item_context)->owner();
+            std::vector<DemuxStrategy *>::const_iterator iter = 
+                std::find(renditions_.begin(), renditions_.end(), strategy);
+            return iter == renditions_.end() ? 0 : iter - renditions_.begin() + 1;
+        }
+
+        bool DemuxStrategy::is_rendition(
+            DemuxStrategy const * strategy) const
+        {
+            return strategy == this 
+                || std::find(renditions_.begin(), renditions_.end(), strategy) != renditions_.end();
         }
 
         bool DemuxStrategy::next_segment(
@@ -59,6 +97,17 @@ namespace just
 
             SourceTreeItem * tree_item = (SourceTreeItem *)pos.item_context;
             DemuxStrategy * strategy = tree_item->owner();
+            if (rendition_switch_ != size_t(-1)) {
+                DemuxStrategy * target = rendition_switch_ ? renditions_[rendition_switch_ - 1] : this;
+                rendition_switch_ = size_t(-1);
+                if (strategy != target && is_rendition(strategy) && !tree_item->is_inserted()) {
+                    // same index in other rendition follows, offsets continue from pos
+                    LOG_DEBUG("[next_segment] switch rendition after segment " << pos.index);
+                    tree_item = &target->tree_item_;
+                    pos.item_context = tree_item;
+                    strategy = target;
+                }
+            }
             if (strategy != this) { // ת
                 return strategy->next_segment(pos, ec);
             }
@@ -130,6 +179,13 @@ namespace just
         {
             just::data::SegmentPosition old_base = base;
 
+            // switch is for the download path, not for walking here, caller resyncs after seek
+            rendition_switch_ = size_t(-1);
+
+            if (old_base.item_context == NULL && time_index_usable()) {
+                time_index_seek(time, base, pos);
+            }
+
             if (time < pos.time_range.big_beg()) {
                 base = just::data::SegmentPosition();
                 pos = just::data::SegmentPosition();
@@ -137,6 +193,7 @@ namespace just
                     assert(0);
                     return false;
                 }
+                time_index_walk(pos);
             }
 
             while (time >= pos.time_range.big_end()) {
@@ -147,6 +204,7 @@ namespace just
                 if (!next_segment(pos, ec)) {
                     return false;
                 }
+                time_index_walk(pos);
             }
 
             pos.time_range.pos = time - pos.time_range.big_offset;
@@ -154,5 +212,82 @@ namespace just
             return true;
         }
 
+        bool DemuxStrategy::time_index_usable()
+        {
+            // inserted strategies make index of segments differ from order of positions
+            if (time_index_disabled_ || tree_item_.next() != NULL) {
+                time_index_.clear();
+                time_index_end_ = 0;
+                return false;
+            }
+            // live window slides, same segment index means other segment later
+            just::data::MediaInfo media_info;
+            boost::system::error_code ec;
+            if (!media_.get_info(media_info, ec))
+                return false;
+            if (media_info.type == just::data::MediaInfo::live) {
+                time_index_disabled_ = true;
+                time_index_.clear();
+                time_index_end_ = 0;
+                return false;
+            }
+            // playlist changed, live or reloaded
+            if (time_index_count_ != media_.segment_count()) {
+                time_index_.clear();
+                time_index_end_ = 0;
+                time_index_count_ = media_.segment_count();
+            }
+            return true;
+        }
+
+        void DemuxStrategy::time_index_seek(
+            boost::uint64_t time, 
+            just::data::SegmentPosition & base,
+            just::data::SegmentPosition & pos)
+        {
+            // last indexed position begins not after time
+            size_t lo = 0;
+            size_t hi = time_index_.size();
+            while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                if (time_index_[mid].time_range.big_beg() <= time) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            if (lo == 0)
+                return;
+            just::data::SegmentPosition const & near = time_index_[lo - 1];
+            // only jump forward, or backward instead of restart from first segment
+            if (pos.item_context == &tree_item_ 
+                && time >= pos.time_range.big_beg() 
+                && pos.index != size_t(-1) 
+                && pos.index >= near.index) {
+                    return;
+            }
+            LOG_DEBUG("[time_index_seek] time: " << time << ", segment: " << near.index);
+            base = just::data::SegmentPosition();
+            pos = near;
+        }
+
+        void DemuxStrategy::time_index_walk(
+            just::data::SegmentPosition const & pos)
+        {
+            if (time_index_disabled_ 
+                || pos.item_context != &tree_item_ 
+                || pos.index != time_index_end_) {
+                    return;
+            }
+            if (pos.byte_range.end == boost::uint64_t(-1)) {
+                time_index_disabled_ = true;
+                return;
+            }
+            if (pos.index % TIME_INDEX_STEP == 0) {
+                time_index_.push_back(pos);
+            }
+            ++time_index_end_;
+        }
+
     } // namespace demux
 } // namespace just
@@ -73,6 +73,20 @@ namespace just
                 return 0;
             }
 
+        public:
+            // alternate rendition of same timeline, segment aligned with us, take ownership
+            // rendition 0 is ourself
+            void add_rendition(
+                DemuxStrategy * strategy);
+
+            // segments after current write segment come from this rendition
+            void switch_rendition(
+                size_t index);
+
+            // rendition of position, 0 if not in any alternate rendition
+            size_t rendition_of(
+                just::data::SegmentPosition const & pos) const;
+
         public:
             virtual bool reset(
                 boost::uint64_t & time, 
@@ -84,6 +98,25 @@ namespace just
                 just::data::SegmentPosition & pos, 
                 boost::system::error_code & ec);
 
+        private:
+            // jump to indexed position near time, only for plain segment list
+            void time_index_seek(
+                boost::uint64_t time, 
+                just::data::SegmentPosition & base,
+                just::data::SegmentPosition & pos);
+
+            // record position just walked to by next_segment
+            void time_index_walk(
+                just::data::SegmentPosition const & pos);
+
+            bool time_index_usable();
+
+            bool is_rendition(
+                DemuxStrategy const * strategy) const;
+
+        private:
+            static size_t const TIME_INDEX_STEP = 64;
+
         private:
             SourceTreeItem tree_item_;
             SourceTreeItem insert_item_;    // ڵ㱻иĺһ
@@ -92,6 +125,13 @@ namespace just
             boost::uint64_t insert_size_;   // ڷֶϵƫλãڷֶʼλã޷
             boost::uint64_t insert_delta_;  // Ҫظص
             boost::uint64_t insert_time_;   // ڷֶϵʱλãڷֶʼλãλ΢
+            // every TIME_INDEX_STEP segment positions, covers [0, time_index_end_) of plain list
+            std::vector<just::data::SegmentPosition> time_index_;
+            size_t time_index_end_;
+            size_t time_index_count_; // segment count when index built
+            bool time_index_disabled_; // segments of unknown size, positions depend on base
+            std::vector<DemuxStrategy *> renditions_; // except ourself
+            size_t rendition_switch_; // pending, -1 if none
         };
 
     } // namespace demux
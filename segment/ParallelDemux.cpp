@@ -0,0 +1,291 @@
+// ParallelDemux.cpp
+
+#include "just/demux/Common.h"
+#include "just/demux/segment/ParallelDemux.h"
+#include "just/demux/basic/BasicDemuxer.h"
+
+using namespace just::avformat::error;
+
+#include <just/data/base/DataBlock.h>
+using namespace just::data;
+
+#include <framework/logger/Logger.h>
+#include <framework/logger/StreamRecord.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/atomic.hpp>
+
+#include <algorithm>
+
+FRAMEWORK_LOGGER_DECLARE_MODULE_LEVEL("just.demux.ParallelDemux", framework::logger::Debug);
+
+namespace just
+{
+    namespace demux
+    {
+
+        // whole segment in memory, seekable for demuxer
+        class MemoryStreamBuffer
+            : public std::basic_streambuf<boost::uint8_t>
+        {
+        public:
+            void reset(
+                boost::uint8_t * data, 
+                size_t size)
+            {
+                setg(data, data, data + size);
+            }
+
+        private:
+            virtual pos_type seekoff(
+                off_type off, 
+                std::ios_base::seekdir dir, 
+                std::ios_base::openmode mode)
+            {
+                if (dir == std::ios_base::cur) {
+                    off += gptr() - eback();
+                } else if (dir == std::ios_base::end) {
+                    off += egptr() - eback();
+                }
+                return seekpos(pos_type(off), mode);
+            }
+
+            virtual pos_type seekpos(
+                pos_type position, 
+                std::ios_base::openmode mode)
+            {
+                // whole segment is here, in|out (move download position) is same as in
+                if ((mode & std::ios_base::in) == 0) {
+                    return pos_type(-1); // read only
+                }
+                off_type off = position;
+                if (off < 0 || off > egptr() - eback()) {
+                    return pos_type(-1);
+                }
+                setg(eback(), eback() + off, egptr());
+                return position;
+            }
+        };
+
+        struct ParallelDemux::Job
+        {
+            MemoryLock lock; // in every sample given out, pointer to job
+            std::vector<boost::uint8_t> bytes;
+            MemoryStreamBuffer buf;
+            BasicDemuxer * demuxer;
+            JointContext context;
+            boost::uint64_t seek_time;
+            std::vector<Sample> samples;
+            boost::system::error_code ec;
+            bool done;
+            bool retired;
+            boost::atomic<bool> abandoned; // cleared while running, worker deletes it
+            size_t next;
+            size_t nref;
+
+            Job()
+                : demuxer(NULL)
+                , seek_time(0)
+                , done(false)
+                , retired(false)
+                , abandoned(false)
+                , next(0)
+                , nref(0)
+            {
+                lock.pointer = this;
+            }
+
+            ~Job()
+            {
+                if (demuxer) {
+                    boost::system::error_code ec;
+                    demuxer->close(ec);
+                    delete demuxer;
+                }
+            }
+        };
+
+        ParallelDemux::ParallelDemux(
+            boost::asio::io_service & io_svc, 
+            size_t workers)
+            : io_svc_(io_svc)
+            , work_io_svc_(new boost::asio::io_service)
+            , work_(new boost::asio::io_service::work(*work_io_svc_))
+            , threads_(new boost::thread_group)
+        {
+            for (size_t i = 0; i < workers; ++i) {
+                threads_->create_thread(
+                    boost::bind(&boost::asio::io_service::run, work_io_svc_));
+            }
+        }
+
+        ParallelDemux::~ParallelDemux()
+        {
+            clear();
+            delete work_;
+            threads_->join_all();
+            delete threads_;
+            delete work_io_svc_;
+            // samples should have been freed before close
+            for (size_t i = 0; i < retired_.size(); ++i) {
+                delete retired_[i];
+            }
+        }
+
+        bool ParallelDemux::submit(
+            std::string const & format, 
+            JointContext const & context, 
+            std::vector<boost::uint8_t> & bytes, 
+            boost::uint64_t seek_time, 
+            boost::system::error_code & ec)
+        {
+            Job * job = new Job;
+            job->bytes.swap(bytes);
+            job->buf.reset(job->bytes.empty() ? NULL : &job->bytes[0], job->bytes.size());
+            // create here, config registry is not thread safe
+            job->demuxer = BasicDemuxerFactory::create(format, io_svc_, job->buf, ec);
+            if (job->demuxer == NULL) {
+                delete job;
+                return false;
+            }
+            job->context = context;
+            job->seek_time = seek_time;
+            {
+                boost::mutex::scoped_lock lock(mutex_);
+                jobs_.push_back(job);
+            }
+            work_io_svc_->post(boost::bind(&ParallelDemux::work, this, job));
+            ec.clear();
+            return true;
+        }
+
+        bool ParallelDemux::get_sample(
+            Sample & sample, 
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            while (!jobs_.empty()) {
+                Job * job = jobs_.front();
+                if (!job->done) {
+                    break;
+                }
+                if (job->next < job->samples.size()) {
+                    sample = job->samples[job->next++];
+                    ++job->nref;
+                    ec.clear();
+                    return true;
+                }
+                jobs_.pop_front();
+                ec = job->ec;
+                release(job);
+                if (ec) {
+                    LOG_WARN("[get_sample] segment failed, ec: " << ec.message());
+                    return false;
+                }
+            }
+            ec = boost::asio::error::would_block;
+            return false;
+        }
+
+        void ParallelDemux::free_sample(
+            Sample & sample)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            Job * job = (Job *)sample.memory->pointer;
+            sample.memory = NULL;
+            sample.data.clear();
+            if (--job->nref == 0 && job->retired) {
+                retired_.erase(std::find(retired_.begin(), retired_.end(), job));
+                delete job;
+            }
+        }
+
+        void ParallelDemux::async_prepare_data(
+            sample_response_type const & resp)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            if (jobs_.empty() || jobs_.front()->done) {
+                io_svc_.post(boost::bind(resp, boost::system::error_code()));
+            } else {
+                resp_ = resp;
+            }
+        }
+
+        void ParallelDemux::clear()
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            // don't wait for running jobs, seek should not stall on them
+            for (size_t i = 0; i < jobs_.size(); ++i) {
+                if (jobs_[i]->done) {
+                    release(jobs_[i]);
+                } else {
+                    jobs_[i]->abandoned = true;
+                }
+            }
+            jobs_.clear();
+        }
+
+        void ParallelDemux::work(
+            Job * job)
+        {
+            if (job->abandoned) {
+                delete job;
+                return;
+            }
+            boost::system::error_code ec;
+            job->demuxer->joint_begin(job->context);
+            job->demuxer->open(ec);
+            if (!ec && job->seek_time != (boost::uint64_t)-1) {
+                boost::uint64_t time = job->seek_time;
+                job->demuxer->seek(time, ec);
+            }
+            Sample sample;
+            while (!ec && !job->abandoned && !job->demuxer->get_sample(sample, ec)) {
+                // data blocks are offsets in segment
+                std::vector<DataBlock> const & blocks = *(std::vector<DataBlock> const *)sample.context;
+                sample.data.clear();
+                for (size_t i = 0; i < blocks.size(); ++i) {
+                    sample.data.push_back(boost::asio::buffer(&job->bytes[(size_t)blocks[i].offset], blocks[i].size));
+                }
+                sample.context = NULL;
+                sample.memory = &job->lock;
+                job->samples.push_back(sample);
+            }
+            if (ec == file_stream_error || ec == end_of_stream) {
+                ec.clear();
+            }
+            job->demuxer->joint_end();
+            sample_response_type resp;
+            {
+                boost::mutex::scoped_lock lock(mutex_);
+                if (job->abandoned) {
+                    // no sample given out, not in jobs_ any more
+                    lock.unlock();
+                    delete job;
+                    return;
+                }
+                job->ec = ec;
+                job->done = true;
+                if (!jobs_.empty() && jobs_.front() == job) {
+                    resp.swap(resp_);
+                }
+            }
+            if (!resp.empty()) {
+                io_svc_.post(boost::bind(resp, boost::system::error_code()));
+            }
+        }
+
+        void ParallelDemux::release(
+            Job * job)
+        {
+            if (job->nref == 0) {
+                delete job;
+            } else {
+                job->retired = true;
+                retired_.push_back(job);
+            }
+        }
+
+    } // namespace demux
+} // namespace just
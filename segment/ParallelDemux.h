@@ -0,0 +1,91 @@
+// ParallelDemux.h
+
+#ifndef _JUST_DEMUX_SEGMENT_PARALLEL_DEMUX_H_
+#define _JUST_DEMUX_SEGMENT_PARALLEL_DEMUX_H_
+
+#include "just/demux/base/DemuxerBase.h"
+#include "just/demux/basic/JointContext.h"
+
+#include <boost/thread/mutex.hpp>
+
+namespace boost
+{
+    class thread_group;
+}
+
+namespace just
+{
+    namespace demux
+    {
+
+        // Demuxes whole segments already in buffer on worker threads
+        // each segment gets its own demuxer and a copy of joint context taken at segment begin,
+        // only for formats that carry nothing between segments (no joint data, no share info),
+        // samples are given out in segment order
+        // costs a copy of each segment and a second header parse, measure before turning on
+        class ParallelDemux
+        {
+        public:
+            typedef DemuxerBase::sample_response_type sample_response_type;
+
+        public:
+            ParallelDemux(
+                boost::asio::io_service & io_svc, 
+                size_t workers);
+
+            ~ParallelDemux();
+
+        public:
+            // bytes: whole segment, swapped out
+            // seek_time: start from, -1 for segment begin
+            bool submit(
+                std::string const & format, 
+                JointContext const & context, 
+                std::vector<boost::uint8_t> & bytes, 
+                boost::uint64_t seek_time, 
+                boost::system::error_code & ec);
+
+            // segments submitted and not given out yet
+            size_t pending() const
+            {
+                return jobs_.size();
+            }
+
+            // would_block if no segment or first one not finished
+            bool get_sample(
+                Sample & sample, 
+                boost::system::error_code & ec);
+
+            void free_sample(
+                Sample & sample);
+
+            void async_prepare_data(
+                sample_response_type const & resp);
+
+            // drop all segments, running ones are abandoned and deleted by their worker
+            void clear();
+
+        private:
+            struct Job;
+
+            void work(
+                Job * job);
+
+            void release(
+                Job * job);
+
+        private:
+            boost::asio::io_service & io_svc_;
+            boost::asio::io_service * work_io_svc_;
+            boost::asio::io_service::work * work_;
+            boost::thread_group * threads_;
+            boost::mutex mutex_;
+            std::deque<Job *> jobs_; // in segment order
+            std::vector<Job *> retired_; // given out, samples still held
+            sample_response_type resp_;
+        };
+
+    } // namespace demux
+} // namespace just
+
+#endif // _JUST_DEMUX_SEGMENT_PARALLEL_DEMUX_H_
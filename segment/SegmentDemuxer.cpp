@@ -4,6 +4,7 @@
 #include "just/demux/segment/SegmentDemuxer.h"
 #include "just/demux/segment/DemuxerInfo.h"
 #include "just/demux/segment/DemuxStrategy.h"
+#include "just/demux/segment/ParallelDemux.h"
 #include "just/demux/basic/JointData.h"
 
 using namespace just::avformat::error;
@@ -39,9 +40,15 @@ namespace just
             , source_time_out_(5000)
             , buffer_capacity_(10 * 1024 * 1024)
             , buffer_read_size_(10 * 1024)
+            , probe_size_(BasicDemuxerFactory::DEFAULT_PROBE_WINDOW)
             , read_demuxer_(NULL)
             , write_demuxer_(NULL)
             , max_demuxer_infos_(5)
+            , abr_(config_)
+            , parallel_(NULL)
+            , parallel_count_(0)
+            , parallel_seek_(0)
+            , parallel_end_(false)
             , seek_time_(0)
             , seek_pending_(false)
             , open_state_(closed)
@@ -52,6 +59,13 @@ namespace just
             config_.register_module("Buffer")
                 << CONFIG_PARAM_NAME_RDWR("capacity", buffer_capacity_)
                 << CONFIG_PARAM_NAME_RDWR("read_size", buffer_read_size_);
+
+            config_.register_module("Probe")
+                << CONFIG_PARAM_NAME_RDWR("size", probe_size_);
+
+            config_.register_module("Segment")
+                << CONFIG_PARAM_NAME_RDWR("cache_size", max_demuxer_infos_)
+                << CONFIG_PARAM_NAME_RDWR("parallel", parallel_count_);
         }
 
         SegmentDemuxer::~SegmentDemuxer()
@@ -112,6 +126,11 @@ namespace just
 
             stream_infos_.clear();
 
+            if (parallel_) {
+                delete parallel_;
+                parallel_ = NULL;
+            }
+
             for (boost::uint32_t i = 0; i < demuxer_infos_.size(); ++i) {
                 delete demuxer_infos_[i]->demuxer;
                 delete demuxer_infos_[i];
@@ -124,6 +143,7 @@ namespace just
                 delete buffer_;
                 buffer_ = NULL;
             }
+            release_buffer();
             if (source_) {
                 source_->close(ec);
                 util::stream::UrlSource * source = const_cast<util::stream::UrlSource *>(&source_->source());
@@ -149,17 +169,31 @@ namespace just
                 return;
             }
 
+            DemuxStatistic::open_wait_end();
             switch(open_state_) {
                 case closed:
                     open_state_ = media_open;
                     DemuxStatistic::open_beg_media();
+                    DemuxStatistic::open_phase_beg(phase_media, 0);
                     media_.async_open(
-                        boost::bind(&SegmentDemuxer::handle_async_open, this, _1));
+                        strand().wrap(boost::bind(&SegmentDemuxer::handle_async_open, this, _1)));
                     break;
                 case media_open:
                     media_.get_info(media_info_, ec);
+                    if (!ec) {
+                        acquire_buffer(buffer_capacity_, media_info_.bitrate, ec);
+                    }
                     if (!ec) {
                         strategy_ = new DemuxStrategy(media_);
+                        abr_.reset();
+                        abr_.add_rendition(media_info_.bitrate);
+                        for (size_t i = 0; i < renditions_.size(); ++i) {
+                            just::data::MediaInfo info;
+                            boost::system::error_code ec1;
+                            renditions_[i]->get_info(info, ec1);
+                            strategy_->add_rendition(new DemuxStrategy(*renditions_[i]));
+                            abr_.add_rendition(info.bitrate);
+                        }
                         util::stream::UrlSource * source = 
                             util::stream::UrlSourceFactory::create(get_io_service(), media_.get_protocol(), ec);
                         if (source == NULL) {
@@ -170,10 +204,15 @@ namespace just
                             source->set_non_block(true, ec1);
                             source_ = new just::data::SegmentSource(*strategy_, *source);
                             source_->set_time_out(source_time_out_);
-                            buffer_ = new just::data::SegmentBuffer(*source_, buffer_capacity_, buffer_read_size_);
+                            buffer_ = new just::data::SegmentBuffer(*source_, granted_buffer(), buffer_read_size_);
                             open_state_ = demuxer_open;
                             DemuxStatistic::open_beg_stream();
+                            DemuxStatistic::open_phase_beg(phase_probe, 0);
                             joint_context_.media_flags(media_info_.flags);
+                            // live segments come one by one, smoth timestamps need previous segment
+                            if (parallel_count_ && media_info_.type != just::data::MediaInfo::live && !joint_context_.smoth()) {
+                                parallel_ = new ParallelDemux(get_io_service(), parallel_count_);
+                            }
                             buffer_->pause_stream();
                             reset(ec);
                         }
@@ -189,16 +228,26 @@ namespace just
                             }
                         }
                         buffer_->set_track_count(stream_count);
+                        if (parallel_ && read_demuxer_->demuxer->joint_carry()) {
+                            // joint data is owned by one context, it can't go to workers
+                            LOG_INFO("[handle_async_open] format " << media_info_.format_type << " joints segments, no parallel demux");
+                            delete parallel_;
+                            parallel_ = NULL;
+                        }
                         open_state_ = opened;
+                        DemuxStatistic::open_phase_end(buffer_->out_position());
+                        DemuxStatistic::open_phase_merge(*read_demuxer_->demuxer);
                         DemuxStatistic::open_end();
                         response(ec);
                     } else if (ec == boost::asio::error::would_block || (ec == file_stream_error 
                         && buffer_->last_error() == boost::asio::error::would_block)) {
+                            DemuxStatistic::open_wait_beg();
                             buffer_->async_prepare_some(0, 
-                                boost::bind(&SegmentDemuxer::handle_async_open, this, _1));
+                                strand().wrap(boost::bind(&SegmentDemuxer::handle_async_open, this, _1)));
                     } else {
                         open_state_ = opened;
                         DemuxStatistic::last_error(ec);
+                        DemuxStatistic::open_phase_end(buffer_ ? buffer_->out_position() : 0);
                         DemuxStatistic::open_end();
                         response(ec);
                     }
@@ -270,11 +319,18 @@ namespace just
                 if (!ec) {
                     LOG_DEBUG("[seek] ok, adjust time: " << time);
                     seek_pending_ = false;
+                    // seek may land in another rendition than the one last selected
+                    abr_.seek(strategy_->rendition_of(buffer_->read_segment()));
                     boost::system::error_code ec1;
                     if (write_demuxer_)
                         free_demuxer(write_demuxer_, false, ec1);
                     buffer_->pause_stream();
                     write_demuxer_ = alloc_demuxer(buffer_->write_segment(), false, ec1);
+                    if (parallel_) {
+                        parallel_->clear();
+                        parallel_seek_ = time;
+                        parallel_end_ = false;
+                    }
                 } else if (ec == file_stream_error) {
                     if (buffer_->read_has_more()) {
                         boost::uint64_t duration = read_demuxer_->demuxer->get_duration(ec);
@@ -314,6 +370,8 @@ namespace just
             seek_time_ = time; // ûseekһΪ׼
             if (&time != &seek_time_ && open_state_ == opened) {
                 DemuxStatistic::seek(!ec, time);
+                latency_mark(LatencyStat::seek);
+                track_seek();
             }
             if (ec) {
                 seek_pending_ = true;
@@ -339,6 +397,7 @@ namespace just
             boost::system::error_code & ec)
         {
             source_->pause();
+            buffer_active(false);
             DemuxStatistic::pause();
             ec.clear();
             return ec;
@@ -348,6 +407,7 @@ namespace just
             boost::system::error_code & ec)
         {
             buffer_->prepare_some(ec);
+            buffer_active(true);
             DemuxStatistic::resume();
             return ec;
         }
@@ -440,12 +500,66 @@ namespace just
             Sample & sample, 
             boost::system::error_code & ec)
         {
+            boost::uint64_t beg = latency_now();
             buffer_->prepare_some(ec);
             if (seek_pending_ && seek(seek_time_, ec)) {
+                latency_end(beg, ec);
                 return ec;
             }
             assert(!seek_pending_);
 
+            get_sample2(sample, ec);
+            if (!ec) {
+                DemuxStatistic::play_on(sample.time);
+            } else {
+                DemuxStatistic::last_error(ec);
+            }
+            latency_end(beg, ec);
+            return ec;
+        }
+
+        size_t SegmentDemuxer::get_samples(
+            Sample * samples, 
+            size_t max_count, 
+            size_t max_bytes, 
+            boost::system::error_code & ec)
+        {
+            boost::uint64_t beg = latency_now();
+            buffer_->prepare_some(ec);
+            if (seek_pending_ && seek(seek_time_, ec)) {
+                latency_end(beg, ec);
+                return 0;
+            }
+            assert(!seek_pending_);
+
+            size_t count = 0;
+            size_t bytes = 0;
+            while (count < max_count && bytes < max_bytes) {
+                get_sample2(samples[count], ec);
+                if (ec)
+                    break;
+                bytes += samples[count].size;
+                ++count;
+            }
+            // ec is kept with count, caller sees why the pass stopped
+            if (count) {
+                DemuxStatistic::play_on(samples[count - 1].time);
+                latency_end(beg, boost::system::error_code());
+            } else {
+                DemuxStatistic::last_error(ec);
+                latency_end(beg, ec);
+            }
+            return count;
+        }
+
+        void SegmentDemuxer::get_sample2(
+            Sample & sample, 
+            boost::system::error_code & ec)
+        {
+            if (parallel_) {
+                get_sample_parallel(sample, ec);
+                return;
+            }
             if (sample.memory) {
                 buffer_->putback(sample.memory);
                 sample.memory = NULL;
@@ -456,25 +570,8 @@ namespace just
                     break;
                 }
                 if (buffer_->read_has_more()) {
-                    LOG_DEBUG("[get_sample] finish segment " << buffer_->read_segment().index);
-                    boost::uint64_t duration = read_demuxer_->demuxer->get_duration(ec);
-                    free_demuxer(read_demuxer_, true, ec);
-                    boost::uint64_t min_offset = buffer_->read_segment().byte_range.end;
-                    if (joint_context_.read_ctx().data()) {
-                        min_offset = joint_context_.read_ctx().data()->adjust_offset(buffer_->read_segment().byte_range.end);
-                    }
-                    // ֹ read_segment ǰ write_segment
-                    get_end_time(ec);
-                    buffer_->read_next(duration, min_offset, ec);
-                    if (buffer_->read_segment().valid()) {
-                        read_demuxer_ = alloc_demuxer(buffer_->read_segment(), true, ec);
-                        //read_demuxer_->demuxer->joint_begin(joint_context_);
-                        //if (!ec) { // Ѿ򿪣Ҫعʼλ
-                        //    read_demuxer_->demuxer->reset(ec);
-                        //}
+                    if (read_next_segment(ec)) {
                         continue;
-                    } else {
-                        ec = end_of_stream;
                     }
                 } else if (ec == end_of_stream && !buffer_->last_error()) {
                     ec = boost::asio::error::would_block;
@@ -490,7 +587,6 @@ namespace just
                 }
             }
             if (!ec) {
-                DemuxStatistic::play_on(sample.time);
                 sample.memory = buffer_->fetch(
                     sample.itrack, 
                     *(std::vector<DataBlock> *)sample.context, 
@@ -498,10 +594,81 @@ namespace just
                     sample.data, 
                     ec);
                 assert(!ec);
-            } else {
-                DemuxStatistic::last_error(ec);
+                track_sample(sample);
             }
-            return ec;
+        }
+
+        bool SegmentDemuxer::read_next_segment(
+            boost::system::error_code & ec)
+        {
+            LOG_DEBUG("[read_next_segment] finish segment " << buffer_->read_segment().index);
+            latency_mark(LatencyStat::segment_switch);
+            boost::uint64_t duration = read_demuxer_->demuxer->get_duration(ec);
+            free_demuxer(read_demuxer_, true, ec);
+            boost::uint64_t min_offset = buffer_->read_segment().byte_range.end;
+            if (joint_context_.read_ctx().data()) {
+                min_offset = joint_context_.read_ctx().data()->adjust_offset(buffer_->read_segment().byte_range.end);
+            }
+            // ֹ read_segment ǰ write_segment
+            get_end_time(ec);
+            buffer_->read_next(duration, min_offset, ec);
+            if (buffer_->read_segment().valid()) {
+                read_demuxer_ = alloc_demuxer(buffer_->read_segment(), true, ec);
+                return true;
+            }
+            ec = end_of_stream;
+            return false;
+        }
+
+        void SegmentDemuxer::get_sample_parallel(
+            Sample & sample, 
+            boost::system::error_code & ec)
+        {
+            if (sample.memory) {
+                parallel_->free_sample(sample);
+            }
+            sample.data.clear();
+            // hand segments complete in buffer to workers, parse less than download
+            while (!parallel_end_ && read_demuxer_ && parallel_->pending() < parallel_count_) {
+                bool has_more = buffer_->read_has_more();
+                if (!has_more && buffer_->last_error() != just::data::error::no_more_segment) {
+                    break;
+                }
+                std::basic_streambuf<boost::uint8_t> & stream = read_demuxer_->stream;
+                std::streamoff size = stream.pubseekoff(0, std::ios::end, std::ios::in);
+                std::vector<boost::uint8_t> bytes((size_t)size);
+                stream.pubseekpos(0, std::ios::in);
+                if (size) {
+                    stream.sgetn(&bytes[0], size);
+                }
+                if (!parallel_->submit(media_info_.format_type, parallel_context_, bytes, parallel_seek_, ec)) {
+                    return;
+                }
+                parallel_seek_ = (boost::uint64_t)-1;
+                if (!has_more || !read_next_segment(ec)) {
+                    parallel_end_ = true;
+                }
+            }
+            if (parallel_->get_sample(sample, ec)) {
+                sample.stream_info = &stream_infos_[sample.itrack];
+                track_sample(sample);
+            } else if (ec == boost::asio::error::would_block && parallel_->pending() == 0) {
+                if (parallel_end_) {
+                    ec = end_of_stream;
+                } else if (buffer_->last_error() && buffer_->last_error() != boost::asio::error::would_block) {
+                    ec = buffer_->last_error();
+                }
+            }
+        }
+
+        void SegmentDemuxer::async_prepare_data(
+            sample_response_type const & resp)
+        {
+            if (parallel_ && parallel_->pending()) {
+                parallel_->async_prepare_data(resp);
+                return;
+            }
+            buffer_->async_prepare_some(0, boost::bind(resp, _1));
         }
 
         bool SegmentDemuxer::free_sample(
@@ -509,8 +676,12 @@ namespace just
             boost::system::error_code & ec)
         {
             if (sample.memory) {
-                buffer_->putback(sample.memory);
-                sample.memory = NULL;
+                if (parallel_) {
+                    parallel_->free_sample(sample);
+                } else {
+                    buffer_->putback(sample.memory);
+                    sample.memory = NULL;
+                }
             }
             ec.clear();
             return true;
@@ -555,6 +726,7 @@ namespace just
                 while (buffer_->write_has_more()) {
                     LOG_DEBUG("[get_end_time] finish segment " << write_demuxer_->segment.index);
                     if (buffer_->write_segment().valid()) {
+                        abr_select();
                         boost::uint64_t duration = write_demuxer_->demuxer->get_duration(ec);
                         free_demuxer(write_demuxer_, false, ec);
                         buffer_->write_next(duration, ec);
@@ -583,11 +755,21 @@ namespace just
             bool is_read, 
             boost::system::error_code & ec)
         {
+            // nothing owned is copied, formats with joint data or share info leave parallel at open
+            if (is_read && parallel_ 
+                && joint_context_.share_info() == NULL && joint_context_.read_ctx().data() == NULL) {
+                    parallel_context_ = joint_context_;
+            }
             // demuxer_info.ref ֻڸúɼ
             ec.clear();
-            for (size_t i = 0; i < demuxer_infos_.size(); ++i) {
-                DemuxerInfo & info = *demuxer_infos_[i];
-                if (info.segment.is_same_segment(segment)) {
+            // recent segments are more likely to match
+            for (size_t i = demuxer_infos_.size(); i > 0; --i) {
+                DemuxerInfo & info = *demuxer_infos_[i - 1];
+                // renditions have same segment indexes
+                if (info.segment.item_context == segment.item_context 
+                    && info.segment.is_same_segment(segment)) {
+                    LOG_DEBUG("[alloc_demuxer] reuse segment " << segment.index);
+                    touch_demuxer(i - 1);
                     info.segment = segment;
                     info.attach();
                     if (info.nref == 1) {
@@ -609,6 +791,7 @@ namespace just
                 for (size_t i = 0; i < demuxer_infos_.size(); ++i) {
                     DemuxerInfo & info = *demuxer_infos_[i];
                     if (info.nref == 0) {
+                        touch_demuxer(i);
                         boost::system::error_code ec1;
                         info.demuxer->close(ec1);
                         info.attach();
@@ -628,7 +811,12 @@ namespace just
             if (media_info_.format_type.empty()) {
                 SegmentStream stream(*buffer_, false);
                 buffer_->attach_stream(stream, true);
-                media_info_.format_type = BasicDemuxerFactory::probe(stream, ec);
+                framework::string::Url url;
+                boost::system::error_code ec1;
+                media_.get_url(url, ec1);
+                boost::uint32_t scope = 0;
+                media_info_.format_type = BasicDemuxerFactory::probe(stream, ec1 ? std::string() : url.to_string(), probe_size_, 
+                    buffer_->last_error() == boost::asio::error::eof, scope, ec);
                 buffer_->detach_stream(stream);
                 if (media_info_.format_type.empty()) {
                     if (ec == boost::asio::error::try_again)
@@ -637,6 +825,9 @@ namespace just
                 }
                 LOG_INFO("[alloc_demuxer] detect media format: " << media_info_.format_type);
             }
+            if (open_state_ == demuxer_open) {
+                DemuxStatistic::open_phase_beg(phase_header, buffer_->out_position());
+            }
             DemuxerInfo * info = new DemuxerInfo(*buffer_);
             info->segment = segment;
             buffer_->attach_stream(info->stream, is_read);
@@ -671,5 +862,41 @@ namespace just
             }
         }
 
+        bool SegmentDemuxer::add_rendition(
+            just::data::SegmentMedia & media, 
+            boost::system::error_code & ec)
+        {
+            if (open_state_ != closed) {
+                ec = error::already_open;
+                return false;
+            }
+            just::data::MediaInfo info;
+            if (!media.get_info(info, ec)) {
+                return false;
+            }
+            renditions_.push_back(&media);
+            return true;
+        }
+
+        void SegmentDemuxer::abr_select()
+        {
+            if (abr_.rendition_count() < 2)
+                return;
+            abr_.update(buffer_->in_position());
+            boost::uint64_t read_time = buffer_->read_segment().time_range.big_beg();
+            boost::uint64_t write_time = buffer_->write_segment().time_range.big_beg();
+            size_t current = abr_.current();
+            size_t next = abr_.select(write_time > read_time ? (boost::uint32_t)(write_time - read_time) : 0);
+            if (next != current) {
+                strategy_->switch_rendition(next);
+            }
+        }
+
+        void SegmentDemuxer::touch_demuxer(
+            size_t index)
+        {
+            std::rotate(demuxer_infos_.begin() + index, demuxer_infos_.begin() + index + 1, demuxer_infos_.end());
+        }
+
     } // namespace demux
 } // namespace just
@@ -7,6 +7,7 @@
 #include "just/demux/base/Demuxer.h"
 #include "just/demux/base/DemuxStatistic.h"
 #include "just/demux/basic/JointContext.h"
+#include "just/demux/segment/AbrController.h"
 
 #include <just/data/segment/SegmentMedia.h>
 
@@ -26,6 +27,7 @@ namespace just
     {
 
         class DemuxStrategy;
+        class ParallelDemux;
         struct DemuxerInfo;
 
         class SegmentDemuxer
@@ -89,6 +91,12 @@ namespace just
                 Sample & sample, 
                 boost::system::error_code & ec);
 
+            virtual size_t get_samples(
+                Sample * samples, 
+                size_t max_count, 
+                size_t max_bytes, 
+                boost::system::error_code & ec);
+
             virtual bool free_sample(
                 Sample & sample, 
                 boost::system::error_code & ec);
@@ -101,6 +109,13 @@ namespace just
                 DataStat & stat, 
                 boost::system::error_code & ec) const;
 
+        public:
+            // alternate rendition of our media, already opened, segment aligned
+            // switched at segment boundaries by throughput and buffer level
+            bool add_rendition(
+                just::data::SegmentMedia & media, 
+                boost::system::error_code & ec);
+
         public:
             just::data::SegmentMedia const & media() const
             {
@@ -124,6 +139,9 @@ namespace just
             virtual boost::uint64_t get_end_time(
                 boost::system::error_code & ec);
 
+            virtual void async_prepare_data(
+                sample_response_type const & resp);
+
         protected:
             typedef boost::function<
                 void(void)> event_func;
@@ -146,6 +164,20 @@ namespace just
             bool is_open(
                 boost::system::error_code & ec) const;
 
+            // no statistics and seek check, shared by get_sample and get_samples
+            void get_sample2(
+                Sample & sample, 
+                boost::system::error_code & ec);
+
+            // get_sample2 with whole segments demuxed on workers
+            void get_sample_parallel(
+                Sample & sample, 
+                boost::system::error_code & ec);
+
+            // finish read segment, false if no more segment
+            bool read_next_segment(
+                boost::system::error_code & ec);
+
             void handle_async_open(
                 boost::system::error_code const & ecc);
 
@@ -162,6 +194,13 @@ namespace just
                 bool is_read, 
                 boost::system::error_code & ec);
 
+            // move to most recently used end
+            void touch_demuxer(
+                size_t index);
+
+            // before write segment moves on
+            void abr_select();
+
         private:
             just::data::SegmentMedia & media_;
             DemuxStrategy * strategy_;
@@ -173,6 +212,7 @@ namespace just
             boost::uint32_t source_time_out_; // 5 seconds
             boost::uint32_t buffer_capacity_; // 10M
             boost::uint32_t buffer_read_size_; // 10K
+            boost::uint32_t probe_size_; // 2K
 
         private:
             just::data::MediaInfo media_info_;
@@ -181,8 +221,17 @@ namespace just
 
             DemuxerInfo * read_demuxer_;
             DemuxerInfo * write_demuxer_;
-            std::vector<DemuxerInfo *> demuxer_infos_;
-            boost::uint32_t max_demuxer_infos_;
+            std::vector<DemuxerInfo *> demuxer_infos_; // least recently used first
+            boost::uint32_t max_demuxer_infos_; // config, opened segment demuxers kept for back seek
+
+            std::vector<just::data::SegmentMedia *> renditions_;
+            AbrController abr_;
+
+            ParallelDemux * parallel_;
+            boost::uint32_t parallel_count_; // config, segments demuxed at once in offline pass, 0 for off
+            JointContext parallel_context_; // copy at read segment begin
+            boost::uint64_t parallel_seek_; // for first segment after seek, -1 for none
+            bool parallel_end_;
 
             framework::timer::Ticker * ticker_;
             boost::uint64_t seek_time_;
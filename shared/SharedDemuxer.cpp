@@ -0,0 +1,211 @@
+// SharedDemuxer.cpp
+
+#include "just/demux/Common.h"
+#include "just/demux/shared/SharedDemuxer.h"
+#include "just/demux/shared/SharedSource.h"
+#include "just/demux/base/DemuxError.h"
+
+#include <framework/logger/Logger.h>
+#include <framework/logger/StreamRecord.h>
+
+#include <boost/bind.hpp>
+
+FRAMEWORK_LOGGER_DECLARE_MODULE_LEVEL("just.demux.SharedDemuxer", framework::logger::Debug);
+
+namespace just
+{
+    namespace demux
+    {
+
+        SharedDemuxer::SharedDemuxer(
+            boost::asio::io_service & io_svc, 
+            SharedSource & source)
+            : Demuxer(io_svc)
+            , source_(source)
+            , cursor_(0)
+            , seek_time_(0)
+            , seek_pending_(false)
+            , lost_(false)
+            , opened_(false)
+        {
+        }
+
+        SharedDemuxer::~SharedDemuxer()
+        {
+        }
+
+        boost::system::error_code SharedDemuxer::open (
+            boost::system::error_code & ec)
+        {
+            return Demuxer::open(ec);
+        }
+
+        void SharedDemuxer::async_open(
+            open_response_type const & resp)
+        {
+            resp_ = resp;
+            DemuxStatistic::open_beg_stream();
+            source_.async_open(*this, 
+                strand().wrap(boost::bind(&SharedDemuxer::handle_async_open, this, _1)));
+        }
+
+        void SharedDemuxer::handle_async_open(
+            boost::system::error_code const & ec)
+        {
+            opened_ = !ec;
+            if (ec) {
+                DemuxStatistic::last_error(ec);
+            }
+            open_end();
+            open_response_type resp;
+            resp.swap(resp_);
+            resp(ec);
+        }
+
+        bool SharedDemuxer::is_open(
+            boost::system::error_code & ec)
+        {
+            if (opened_) {
+                ec.clear();
+            } else if (!resp_.empty()) {
+                ec = boost::asio::error::would_block;
+            } else {
+                ec = error::not_open;
+            }
+            return !ec;
+        }
+
+        boost::system::error_code SharedDemuxer::cancel(
+            boost::system::error_code & ec)
+        {
+            source_.cancel(*this);
+            ec.clear();
+            return ec;
+        }
+
+        boost::system::error_code SharedDemuxer::close(
+            boost::system::error_code & ec)
+        {
+            DemuxStatistic::close();
+            opened_ = false;
+            seek_time_ = 0;
+            seek_pending_ = false;
+            lost_ = false;
+            ec.clear();
+            return ec;
+        }
+
+        boost::system::error_code SharedDemuxer::get_media_info(
+            MediaInfo & info, 
+            boost::system::error_code & ec) const
+        {
+            return source_.get_media_info(info, ec);
+        }
+
+        size_t SharedDemuxer::get_stream_count(
+            boost::system::error_code & ec) const
+        {
+            return source_.get_stream_count(ec);
+        }
+
+        boost::system::error_code SharedDemuxer::get_stream_info(
+            size_t index, 
+            StreamInfo & info, 
+            boost::system::error_code & ec) const
+        {
+            return source_.get_stream_info(index, info, ec);
+        }
+
+        bool SharedDemuxer::get_stream_status(
+            StreamStatus & info, 
+            boost::system::error_code & ec)
+        {
+            return source_.get_stream_status(info, ec);
+        }
+
+        bool SharedDemuxer::get_data_stat(
+            DataStat & stat, 
+            boost::system::error_code & ec) const
+        {
+            return source_.get_data_stat(stat, ec);
+        }
+
+        boost::system::error_code SharedDemuxer::seek(
+            boost::uint64_t & time, 
+            boost::system::error_code & ec)
+        {
+            if (!opened_) {
+                ec = error::not_open;
+                return ec;
+            }
+            // only moves this reader, upstream keeps its position
+            source_.seek(*this, time, ec);
+            DemuxStatistic::seek(!ec, time);
+            if (ec) {
+                DemuxStatistic::last_error(ec);
+            }
+            return ec;
+        }
+
+        boost::uint64_t SharedDemuxer::check_seek(
+            boost::system::error_code & ec)
+        {
+            ec.clear();
+            return seek_time_;
+        }
+
+        boost::system::error_code SharedDemuxer::pause(
+            boost::system::error_code & ec)
+        {
+            DemuxStatistic::pause();
+            ec.clear();
+            return ec;
+        }
+
+        boost::system::error_code SharedDemuxer::resume(
+            boost::system::error_code & ec)
+        {
+            DemuxStatistic::resume();
+            ec.clear();
+            return ec;
+        }
+
+        bool SharedDemuxer::fill_data(
+            boost::system::error_code & ec)
+        {
+            return source_.fill_data(ec);
+        }
+
+        boost::system::error_code SharedDemuxer::get_sample(
+            Sample & sample, 
+            boost::system::error_code & ec)
+        {
+            if (sample.memory) {
+                source_.free_sample(sample);
+            }
+            sample.data.clear();
+            if (!opened_) {
+                ec = error::not_open;
+                return ec;
+            }
+            source_.get_sample(*this, sample, ec);
+            return ec;
+        }
+
+        void SharedDemuxer::async_prepare_data(
+            sample_response_type const & resp)
+        {
+            source_.async_prepare_data(resp);
+        }
+
+        bool SharedDemuxer::free_sample(
+            Sample & sample, 
+            boost::system::error_code & ec)
+        {
+            source_.free_sample(sample);
+            ec.clear();
+            return true;
+        }
+
+    } // namespace demux
+} // namespace just
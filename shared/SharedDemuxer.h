@@ -0,0 +1,118 @@
+// SharedDemuxer.h
+
+#ifndef _JUST_DEMUX_SHARED_SHARED_DEMUXER_H_
+#define _JUST_DEMUX_SHARED_SHARED_DEMUXER_H_
+
+#include "just/demux/base/Demuxer.h"
+
+namespace just
+{
+    namespace demux
+    {
+
+        class SharedSource;
+
+        // Reader cursor over a SharedSource
+        class SharedDemuxer
+            : public Demuxer
+        {
+        public:
+            SharedDemuxer(
+                boost::asio::io_service & io_svc, 
+                SharedSource & source);
+
+            virtual ~SharedDemuxer();
+
+        public:
+            virtual boost::system::error_code open (
+                boost::system::error_code & ec);
+
+            virtual void async_open(
+                open_response_type const & resp);
+
+            virtual bool is_open(
+                boost::system::error_code & ec);
+
+            virtual boost::system::error_code cancel(
+                boost::system::error_code & ec);
+
+            virtual boost::system::error_code close(
+                boost::system::error_code & ec);
+
+        public:
+            virtual boost::system::error_code get_media_info(
+                MediaInfo & info, 
+                boost::system::error_code & ec) const;
+
+            virtual size_t get_stream_count(
+                boost::system::error_code & ec) const;
+
+            virtual boost::system::error_code get_stream_info(
+                size_t index, 
+                StreamInfo & info, 
+                boost::system::error_code & ec) const;
+
+            virtual bool get_stream_status(
+                StreamStatus & info, 
+                boost::system::error_code & ec);
+
+            virtual bool get_data_stat(
+                DataStat & stat, 
+                boost::system::error_code & ec) const;
+
+        public:
+            virtual boost::system::error_code seek(
+                boost::uint64_t & time, 
+                boost::system::error_code & ec);
+
+            virtual boost::uint64_t check_seek(
+                boost::system::error_code & ec);
+
+            virtual boost::system::error_code pause(
+                boost::system::error_code & ec);
+
+            virtual boost::system::error_code resume(
+                boost::system::error_code & ec);
+
+            virtual bool fill_data(
+                boost::system::error_code & ec);
+
+        public:
+            virtual boost::system::error_code get_sample(
+                Sample & sample, 
+                boost::system::error_code & ec);
+
+            virtual bool free_sample(
+                Sample & sample, 
+                boost::system::error_code & ec);
+
+        public:
+            SharedSource & source() const
+            {
+                return source_;
+            }
+
+        protected:
+            virtual void async_prepare_data(
+                sample_response_type const & resp);
+
+        private:
+            void handle_async_open(
+                boost::system::error_code const & ec);
+
+        private:
+            friend class SharedSource;
+
+            SharedSource & source_;
+            boost::uint64_t cursor_; // sequence of next sample in ring
+            boost::uint64_t seek_time_;
+            bool seek_pending_; // skip until sync sample after seek_time_
+            bool lost_; // samples dropped before read, mark discontinuity
+            bool opened_;
+            open_response_type resp_;
+        };
+
+    } // namespace demux
+} // namespace just
+
+#endif // _JUST_DEMUX_SHARED_SHARED_DEMUXER_H_
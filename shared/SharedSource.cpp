@@ -0,0 +1,463 @@
+// SharedSource.cpp
+
+#include "just/demux/Common.h"
+#include "just/demux/shared/SharedSource.h"
+#include "just/demux/shared/SharedDemuxer.h"
+#include "just/demux/base/Demuxer.h"
+#include "just/demux/base/DemuxError.h"
+
+#include <just/data/base/MediaBase.h>
+
+#include <framework/logger/Logger.h>
+#include <framework/logger/StreamRecord.h>
+
+#include <boost/bind.hpp>
+
+FRAMEWORK_LOGGER_DECLARE_MODULE_LEVEL("just.demux.SharedSource", framework::logger::Debug);
+
+namespace just
+{
+    namespace demux
+    {
+
+        static size_t const MAX_SPARE_ENTRIES = 32;
+
+        struct SharedSource::Entry
+        {
+            Sample sample;
+            std::vector<boost::uint8_t> data;
+            size_t nref; // samples given to readers
+            bool evicted;
+
+            Entry()
+                : nref(0)
+                , evicted(false)
+            {
+            }
+        };
+
+        SharedSource::SharedSource(
+            DemuxerBase * demuxer, 
+            just::data::MediaBase * media, 
+            size_t max_samples, 
+            size_t max_bytes)
+            : demuxer_(demuxer)
+            , media_(media)
+            , nref_(0)
+            , state_(closed)
+            , first_seq_(0)
+            , bytes_(0)
+            , max_samples_(max_samples)
+            , max_bytes_(max_bytes)
+        {
+        }
+
+        SharedSource::~SharedSource()
+        {
+            for (size_t i = 0; i < ring_.size(); ++i) {
+                delete ring_[i];
+            }
+            ring_.clear();
+            // readers are gone, their samples with them
+            std::set<Entry *>::const_iterator iter = retained_.begin();
+            for (; iter != retained_.end(); ++iter) {
+                delete *iter;
+            }
+            retained_.clear();
+            for (size_t i = 0; i < spare_.size(); ++i) {
+                delete spare_[i];
+            }
+            spare_.clear();
+            boost::system::error_code ec;
+            if (sample_.memory) {
+                demuxer_->free_sample(sample_, ec);
+            }
+            demuxer_->close(ec);
+            delete demuxer_;
+            if (media_)
+                delete media_;
+        }
+
+        size_t SharedSource::attach()
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            return ++nref_;
+        }
+
+        size_t SharedSource::detach()
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            return --nref_;
+        }
+
+        bool SharedSource::shareable()
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            return state_ != opened || media_info_.type == MediaInfo::live;
+        }
+
+        void SharedSource::async_open(
+            SharedDemuxer & reader, 
+            open_response_type const & resp)
+        {
+            bool ready = false;
+            bool start = false;
+            {
+                boost::mutex::scoped_lock lock(mutex_);
+                if (state_ == opened) {
+                    reader.cursor_ = live_position();
+                    ready = true;
+                } else {
+                    waiters_.push_back(std::make_pair(&reader, resp));
+                    if (state_ == closed) {
+                        state_ = opening;
+                        start = true;
+                    }
+                }
+            }
+            if (ready) {
+                reader.get_io_service().post(boost::bind(resp, boost::system::error_code()));
+            }
+            if (start) {
+                LOG_INFO("[async_open] open upstream");
+                demuxer_->async_open(
+                    boost::bind(&SharedSource::handle_open, this, _1));
+            }
+        }
+
+        void SharedSource::handle_open(
+            boost::system::error_code const & ec)
+        {
+            std::vector<std::pair<SharedDemuxer *, open_response_type> > waiters;
+            {
+                boost::mutex::scoped_lock lock(mutex_);
+                if (!ec) {
+                    boost::system::error_code ec1;
+                    demuxer_->get_media_info(media_info_, ec1);
+                    size_t count = demuxer_->get_stream_count(ec1);
+                    stream_infos_.resize(count);
+                    for (size_t i = 0; i < count; ++i) {
+                        demuxer_->get_stream_info(i, stream_infos_[i], ec1);
+                    }
+                    state_ = opened;
+                    if (media_info_.type != MediaInfo::live) {
+                        LOG_WARN("[handle_open] upstream not live, no more readers will share it");
+                    }
+                } else {
+                    LOG_WARN("[handle_open] upstream open failed, ec: " << ec.message());
+                    state_ = closed;
+                }
+                waiters.swap(waiters_);
+                for (size_t i = 0; i < waiters.size(); ++i) {
+                    waiters[i].first->cursor_ = live_position();
+                }
+            }
+            // run on reader's own context, not on upstream's
+            for (size_t i = 0; i < waiters.size(); ++i) {
+                waiters[i].first->get_io_service().post(boost::bind(waiters[i].second, ec));
+            }
+        }
+
+        bool SharedSource::is_open(
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            if (state_ == opened) {
+                ec.clear();
+            } else if (state_ == opening) {
+                ec = boost::asio::error::would_block;
+            } else {
+                ec = error::not_open;
+            }
+            return !ec;
+        }
+
+        void SharedSource::cancel(
+            SharedDemuxer & reader)
+        {
+            open_response_type resp;
+            bool last = false;
+            {
+                boost::mutex::scoped_lock lock(mutex_);
+                for (size_t i = 0; i < waiters_.size(); ++i) {
+                    if (waiters_[i].first == &reader) {
+                        resp.swap(waiters_[i].second);
+                        waiters_.erase(waiters_.begin() + i);
+                        break;
+                    }
+                }
+                last = nref_ == 1;
+            }
+            if (last) {
+                // last reader, upstream is not needed any more
+                boost::system::error_code ec;
+                demuxer_->cancel(ec);
+            }
+            if (!resp.empty()) {
+                reader.get_io_service().post(boost::bind(resp, boost::asio::error::operation_aborted));
+            }
+        }
+
+        boost::system::error_code SharedSource::get_media_info(
+            MediaInfo & info, 
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            if (state_ != opened) {
+                ec = error::not_open;
+            } else {
+                info = media_info_;
+                ec.clear();
+            }
+            return ec;
+        }
+
+        size_t SharedSource::get_stream_count(
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            if (state_ != opened) {
+                ec = error::not_open;
+                return 0;
+            }
+            ec.clear();
+            return stream_infos_.size();
+        }
+
+        boost::system::error_code SharedSource::get_stream_info(
+            size_t index, 
+            StreamInfo & info, 
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            if (state_ != opened) {
+                ec = error::not_open;
+            } else if (index >= stream_infos_.size()) {
+                ec = framework::system::logic_error::out_of_range;
+            } else {
+                info = stream_infos_[index];
+                ec.clear();
+            }
+            return ec;
+        }
+
+        bool SharedSource::get_stream_status(
+            StreamStatus & info, 
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            return demuxer_->get_stream_status(info, ec);
+        }
+
+        bool SharedSource::get_data_stat(
+            DataStat & stat, 
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            return demuxer_->get_data_stat(stat, ec);
+        }
+
+        bool SharedSource::fill_data(
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            return demuxer_->fill_data(ec);
+        }
+
+        bool SharedSource::seek(
+            SharedDemuxer & reader, 
+            boost::uint64_t time, 
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            if (ring_.empty() || ring_.back()->sample.time < time) {
+                // not arrived yet, skip to it later
+                reader.seek_time_ = time;
+                reader.cursor_ = first_seq_ + ring_.size();
+                reader.seek_pending_ = true;
+                ec.clear();
+                return true;
+            }
+            for (size_t i = ring_.size(); i > 0; --i) {
+                Sample const & sample = ring_[i - 1]->sample;
+                if ((sample.flags & sample.f_sync) && sample.time <= time) {
+                    reader.seek_time_ = time;
+                    reader.seek_pending_ = false;
+                    reader.cursor_ = first_seq_ + i - 1;
+                    ec.clear();
+                    return true;
+                }
+            }
+            // already evicted, upstream is not rewound for one reader
+            ec = framework::system::logic_error::out_of_range;
+            return false;
+        }
+
+        bool SharedSource::get_sample(
+            SharedDemuxer & reader, 
+            Sample & sample, 
+            boost::system::error_code & ec)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            if (state_ != opened) {
+                ec = error::not_open;
+                return false;
+            }
+            while (true) {
+                if (reader.cursor_ < first_seq_) {
+                    // reader too slow, samples evicted
+                    reader.cursor_ = sync_after(first_seq_);
+                    reader.lost_ = true;
+                }
+                if (reader.cursor_ >= first_seq_ + ring_.size()) {
+                    if (!pull(ec))
+                        return false;
+                    continue;
+                }
+                Entry * entry = ring_[(size_t)(reader.cursor_ - first_seq_)];
+                ++reader.cursor_;
+                if (reader.seek_pending_) {
+                    if ((entry->sample.flags & entry->sample.f_sync) == 0
+                        || entry->sample.time < reader.seek_time_) {
+                            continue;
+                    }
+                    reader.seek_pending_ = false;
+                }
+                ++entry->nref;
+                sample = entry->sample;
+                sample.memory = entry;
+                if (reader.lost_) {
+                    sample.flags |= sample.f_discontinuity;
+                    reader.lost_ = false;
+                }
+                ec.clear();
+                return true;
+            }
+        }
+
+        void SharedSource::free_sample(
+            Sample & sample)
+        {
+            Entry * entry = (Entry *)sample.memory;
+            if (entry == NULL)
+                return;
+            sample.memory = NULL;
+            boost::mutex::scoped_lock lock(mutex_);
+            if (--entry->nref == 0 && entry->evicted) {
+                retained_.erase(entry);
+                free_entry(entry);
+            }
+        }
+
+        void SharedSource::async_prepare_data(
+            DemuxerBase::sample_response_type const & resp)
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            Demuxer * demuxer = dynamic_cast<Demuxer *>(demuxer_);
+            if (demuxer) {
+                demuxer->async_prepare_data(resp);
+            } else {
+                demuxer_->get_io_service().post(boost::bind(resp, boost::asio::error::would_block));
+            }
+        }
+
+        bool SharedSource::pull(
+            boost::system::error_code & ec)
+        {
+            demuxer_->get_sample(sample_, ec);
+            if (ec) {
+                return false;
+            }
+            Entry * entry = alloc_entry();
+            entry->sample = sample_;
+            size_t size = 0;
+            for (size_t i = 0; i < sample_.data.size(); ++i) {
+                size += boost::asio::buffer_size(sample_.data[i]);
+            }
+            // reused entries already have capacity, only one copy of payload
+            entry->data.resize(size);
+            size = 0;
+            for (size_t i = 0; i < sample_.data.size(); ++i) {
+                size_t n = boost::asio::buffer_size(sample_.data[i]);
+                if (n) {
+                    memcpy(&entry->data[size], boost::asio::buffer_cast<boost::uint8_t const *>(sample_.data[i]), n);
+                    size += n;
+                }
+            }
+            entry->sample.data.clear();
+            if (!entry->data.empty()) {
+                entry->sample.data.push_back(boost::asio::buffer(&entry->data[0], entry->data.size()));
+            }
+            entry->sample.memory = NULL;
+            entry->sample.context = NULL;
+            if (sample_.itrack < stream_infos_.size()) {
+                entry->sample.stream_info = &stream_infos_[sample_.itrack];
+            }
+            boost::system::error_code ec1;
+            demuxer_->free_sample(sample_, ec1);
+
+            ring_.push_back(entry);
+            bytes_ += entry->data.size();
+            evict();
+            return true;
+        }
+
+        void SharedSource::evict()
+        {
+            while (ring_.size() > 1
+                && (ring_.size() > max_samples_ || bytes_ > max_bytes_)) {
+                    Entry * entry = ring_.front();
+                    ring_.pop_front();
+                    ++first_seq_;
+                    bytes_ -= entry->data.size();
+                    if (entry->nref == 0) {
+                        free_entry(entry);
+                    } else {
+                        entry->evicted = true;
+                        retained_.insert(entry);
+                    }
+            }
+        }
+
+        SharedSource::Entry * SharedSource::alloc_entry()
+        {
+            if (spare_.empty())
+                return new Entry;
+            Entry * entry = spare_.back();
+            spare_.pop_back();
+            entry->nref = 0;
+            entry->evicted = false;
+            return entry;
+        }
+
+        void SharedSource::free_entry(
+            Entry * entry)
+        {
+            if (spare_.size() < MAX_SPARE_ENTRIES) {
+                spare_.push_back(entry);
+            } else {
+                delete entry;
+            }
+        }
+
+        boost::uint64_t SharedSource::sync_after(
+            boost::uint64_t seq) const
+        {
+            for (size_t i = (size_t)(seq - first_seq_); i < ring_.size(); ++i) {
+                if (ring_[i]->sample.flags & ring_[i]->sample.f_sync)
+                    return first_seq_ + i;
+            }
+            return first_seq_ + ring_.size();
+        }
+
+        boost::uint64_t SharedSource::live_position() const
+        {
+            for (size_t i = ring_.size(); i > 0; --i) {
+                if (ring_[i - 1]->sample.flags & ring_[i - 1]->sample.f_sync)
+                    return first_seq_ + i - 1;
+            }
+            return first_seq_ + ring_.size();
+        }
+
+    } // namespace demux
+} // namespace just
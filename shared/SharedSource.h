@@ -0,0 +1,161 @@
+// SharedSource.h
+
+#ifndef _JUST_DEMUX_SHARED_SHARED_SOURCE_H_
+#define _JUST_DEMUX_SHARED_SHARED_SOURCE_H_
+
+#include "just/demux/base/DemuxerBase.h"
+
+#include <boost/thread/mutex.hpp>
+
+#include <set>
+
+namespace just
+{
+    namespace data
+    {
+        class MediaBase;
+    }
+
+    namespace demux
+    {
+
+        class SharedDemuxer;
+
+        // One upstream demuxer shared by many SharedDemuxer readers
+        // samples are copied into a ring, readers keep their own positions in it
+        // only for live links, readers can't seek out of the ring, DemuxModule checks media type before sharing
+        class SharedSource
+        {
+        public:
+            typedef DemuxerBase::open_response_type open_response_type;
+
+        public:
+            // take ownership of demuxer and media
+            SharedSource(
+                DemuxerBase * demuxer, 
+                just::data::MediaBase * media, 
+                size_t max_samples, 
+                size_t max_bytes);
+
+            ~SharedSource();
+
+        public:
+            // reader count after change
+            size_t attach();
+
+            size_t detach();
+
+            // created only for live media, false if opened upstream turns out not live anyway
+            bool shareable();
+
+        public:
+            void async_open(
+                SharedDemuxer & reader, 
+                open_response_type const & resp);
+
+            bool is_open(
+                boost::system::error_code & ec);
+
+            void cancel(
+                SharedDemuxer & reader);
+
+        public:
+            boost::system::error_code get_media_info(
+                MediaInfo & info, 
+                boost::system::error_code & ec);
+
+            size_t get_stream_count(
+                boost::system::error_code & ec);
+
+            boost::system::error_code get_stream_info(
+                size_t index, 
+                StreamInfo & info, 
+                boost::system::error_code & ec);
+
+            bool get_stream_status(
+                StreamStatus & info, 
+                boost::system::error_code & ec);
+
+            bool get_data_stat(
+                DataStat & stat, 
+                boost::system::error_code & ec);
+
+            bool fill_data(
+                boost::system::error_code & ec);
+
+        public:
+            // position reader at last sync sample before time
+            // out_of_range if time is already evicted from ring
+            bool seek(
+                SharedDemuxer & reader, 
+                boost::uint64_t time, 
+                boost::system::error_code & ec);
+
+            bool get_sample(
+                SharedDemuxer & reader, 
+                Sample & sample, 
+                boost::system::error_code & ec);
+
+            void free_sample(
+                Sample & sample);
+
+            // complete when upstream has more data
+            void async_prepare_data(
+                DemuxerBase::sample_response_type const & resp);
+
+        private:
+            struct Entry;
+
+            void handle_open(
+                boost::system::error_code const & ec);
+
+            bool pull(
+                boost::system::error_code & ec);
+
+            void evict();
+
+            Entry * alloc_entry();
+
+            // entry not in ring and not given to readers
+            void free_entry(
+                Entry * entry);
+
+            // sequence of first sync entry at or after seq
+            boost::uint64_t sync_after(
+                boost::uint64_t seq) const;
+
+            // where new readers start, last sync entry
+            boost::uint64_t live_position() const;
+
+        private:
+            enum StateEnum
+            {
+                closed, 
+                opening, 
+                opened, 
+            };
+
+            boost::mutex mutex_;
+            DemuxerBase * demuxer_;
+            just::data::MediaBase * media_;
+            size_t nref_;
+
+            StateEnum state_;
+            std::vector<std::pair<SharedDemuxer *, open_response_type> > waiters_;
+            MediaInfo media_info_;
+            std::vector<StreamInfo> stream_infos_;
+
+            Sample sample_; // from upstream
+            std::deque<Entry *> ring_;
+            std::set<Entry *> retained_; // evicted but still given to readers
+            std::vector<Entry *> spare_; // reused, keep their data capacity
+            boost::uint64_t first_seq_; // sequence of ring_.front()
+            size_t bytes_;
+            size_t max_samples_;
+            size_t max_bytes_;
+        };
+
+    } // namespace demux
+} // namespace just
+
+#endif // _JUST_DEMUX_SHARED_SHARED_SOURCE_H_
@@ -12,6 +12,7 @@ using namespace just::avformat::error;
 
 #include <framework/logger/Logger.h>
 #include <framework/logger/StreamRecord.h>
+#include <framework/system/LogicError.h>
 
 #include <boost/bind.hpp>
 
@@ -32,7 +33,14 @@ namespace just
             , seek_time_(0)
             , seek_pending_(false)
             , open_state_(closed)
+            , probe_size_(BasicDemuxerFactory::DEFAULT_PROBE_WINDOW)
+            , buffer_capacity_(10 * 1024 * 1024)
         {
+            config_.register_module("Probe")
+                << CONFIG_PARAM_NAME_RDWR("size", probe_size_);
+
+            config_.register_module("Buffer")
+                << CONFIG_PARAM_NAME_RDWR("capacity", buffer_capacity_);
         }
 
         SingleDemuxer::~SingleDemuxer()
@@ -103,6 +111,7 @@ namespace just
                 delete stream_;
                 stream_ = NULL;
             }
+            release_buffer();
             if (source_) {
                 source_->close(ec);
                 util::stream::UrlSource * source = const_cast<util::stream::UrlSource *>(&source_->source());
@@ -118,11 +127,24 @@ namespace just
         bool SingleDemuxer::create_demuxer(
             boost::system::error_code & ec)
         {
-            if (media_info_.format_type.empty()) {
-                media_info_.format_type = BasicDemuxerFactory::probe(*stream_, ec);
-                if (media_info_.format_type.empty()) {
+            if (media_info_.format_type.empty() || !probe_check_.empty()) {
+                boost::uint32_t scope = 0;
+                std::string format = BasicDemuxerFactory::probe(*stream_, url_.to_string(), probe_size_, 
+                    stream_->last_error() == boost::asio::error::eof, scope, ec);
+                if (format.empty()) {
+                    if (ec == boost::asio::error::try_again || media_info_.format_type.empty()) {
+                        return false;
+                    }
+                    // bytes not recognized, only format hint left
+                    format = media_info_.format_type;
+                    ec.clear();
+                }
+                if (!probe_check_.empty() && !probe_check_(format, scope)) {
+                    LOG_INFO("[create_demuxer] rejected, format: " << format << ", scope: " << scope);
+                    ec = framework::system::logic_error::not_supported;
                     return false;
                 }
+                media_info_.format_type = format;
             }
             BasicDemuxer * demuxer = BasicDemuxerFactory::create(media_info_.format_type, get_io_service(), *stream_, ec);
             if (demuxer) {
@@ -142,16 +164,21 @@ namespace just
                 return;
             }
 
+            DemuxStatistic::open_wait_end();
             switch(open_state_) {
                 case closed:
                     open_state_ = media_open;
                     DemuxStatistic::open_beg_media();
+                    DemuxStatistic::open_phase_beg(phase_media, 0);
                     media_.async_open(
-                        boost::bind(&SingleDemuxer::handle_async_open, this, _1));
+                        strand().wrap(boost::bind(&SingleDemuxer::handle_async_open, this, _1)));
                     break;
                 case media_open:
                     media_.get_info(media_info_, ec);
                     media_.get_url(url_, ec);
+                    if (!ec) {
+                        acquire_buffer(buffer_capacity_, media_info_.bitrate, ec);
+                    }
                     if (!ec) {
                         util::stream::UrlSource * source = 
                             util::stream::UrlSourceFactory::create(get_io_service(), media_.get_protocol(), ec);
@@ -160,10 +187,11 @@ namespace just
                             source->set_non_block(true, ec1);
                             source_ = new just::data::SingleSource(url_, *source);
                             source_->set_time_out(5000);
-                            stream_ = new just::data::SingleBuffer(*source_, 10 * 1024 * 1024, 10240);
+                            stream_ = new just::data::SingleBuffer(*source_, granted_buffer(), 10240);
                             // TODO:
                             open_state_ = demuxer_probe;
                             DemuxStatistic::open_beg_stream();
+                            DemuxStatistic::open_phase_beg(phase_probe, 0);
                             stream_->pause_stream();
                             stream_->seek(0, ec);
                             stream_->pause_stream();
@@ -172,11 +200,13 @@ namespace just
                 case demuxer_probe:
                     if (!ec && create_demuxer(ec)) {
                         open_state_ = demuxer_open;
+                        DemuxStatistic::open_phase_beg(phase_header, stream_->out_position());
                         CustomDemuxer::open(ec);
                         CustomDemuxer::reset(ec);
                     } else if (ec == boost::asio::error::try_again) {
+                        DemuxStatistic::open_wait_beg();
                         stream_->async_prepare_some(0, 
-                            boost::bind(&SingleDemuxer::handle_async_open, this, _1));
+                            strand().wrap(boost::bind(&SingleDemuxer::handle_async_open, this, _1)));
                         break;
                     }
                 case demuxer_open:
@@ -192,13 +222,19 @@ namespace just
                         if (media_info_.bitrate == 0 && media_info_.file_size != invalid_size && media_info_.duration != invalid_size) {
                             media_info_.bitrate = (boost::uint32_t)(media_info_.file_size * 8 * 1000 / media_info_.duration);
                         }
+                        DemuxStatistic::open_phase_end(stream_->out_position());
+                        DemuxStatistic * inner = dynamic_cast<DemuxStatistic *>(attached());
+                        if (inner)
+                            DemuxStatistic::open_phase_merge(*inner);
                         DemuxStatistic::open_end();
                         response(ec);
                     } else if (ec == boost::asio::error::would_block || (ec == file_stream_error 
                         && stream_->last_error() == boost::asio::error::would_block)) {
+                            DemuxStatistic::open_wait_beg();
                             stream_->async_prepare_some(0, 
-                                boost::bind(&SingleDemuxer::handle_async_open, this, _1));
+                                strand().wrap(boost::bind(&SingleDemuxer::handle_async_open, this, _1)));
                     } else {
+                        DemuxStatistic::open_phase_end(stream_ ? stream_->out_position() : 0);
                         DemuxStatistic::open_end();
                         response(ec);
                     }
@@ -230,6 +266,7 @@ namespace just
             }
             if (&time != &seek_time_ && open_state_ == opened) {
                 DemuxStatistic::seek(!ec, time);
+                latency_mark(LatencyStat::seek);
             }
             if (ec) {
                 DemuxStatistic::last_error(ec);
@@ -253,6 +290,7 @@ namespace just
             boost::system::error_code & ec)
         {
             source_->pause();
+            buffer_active(false);
             DemuxStatistic::pause();
             ec.clear();
             return ec;
@@ -262,6 +300,7 @@ namespace just
             boost::system::error_code & ec)
         {
             stream_->prepare_some(ec);
+            buffer_active(true);
             DemuxStatistic::resume();
             return ec;
         }
@@ -308,12 +347,20 @@ namespace just
             return !ec;
         }
 
+        void SingleDemuxer::async_prepare_data(
+            sample_response_type const & resp)
+        {
+            stream_->async_prepare_some(0, boost::bind(resp, _1));
+        }
+
         boost::system::error_code SingleDemuxer::get_sample(
             Sample & sample, 
             boost::system::error_code & ec)
         {
+            boost::uint64_t beg = latency_now();
             stream_->prepare_some(ec);
             if (seek_pending_ && seek(seek_time_, ec)) {
+                latency_end(beg, ec);
                 return ec;
             }
             assert(!seek_pending_);
@@ -341,9 +388,65 @@ namespace just
             } else {
                 DemuxStatistic::last_error(ec);
             }
+            latency_end(beg, ec);
             return ec;
         }
 
+        size_t SingleDemuxer::get_samples(
+            Sample * samples, 
+            size_t max_count, 
+            size_t max_bytes, 
+            boost::system::error_code & ec)
+        {
+            boost::uint64_t beg = latency_now();
+            stream_->prepare_some(ec);
+            if (seek_pending_ && seek(seek_time_, ec)) {
+                latency_end(beg, ec);
+                return 0;
+            }
+            assert(!seek_pending_);
+
+            for (size_t i = 0; i < max_count; ++i) {
+                if (samples[i].memory) {
+                    stream_->putback(samples[i].memory);
+                    samples[i].memory = NULL;
+                }
+                samples[i].data.clear();
+            }
+
+            size_t count = CustomDemuxer::get_samples(samples, max_count, max_bytes, ec);
+            if (ec == file_stream_error) {
+                ec = stream_->last_error();
+                assert(ec);
+                if (ec == boost::asio::error::eof)
+                    ec = end_of_stream;
+                if (!ec) {
+                    ec = boost::asio::error::would_block;
+                }
+            }
+            for (size_t i = 0; i < count; ++i) {
+                boost::system::error_code ec1;
+                samples[i].memory = stream_->fetch(samples[i].itrack, *(std::vector<just::data::DataBlock> *)samples[i].context, samples[i].data, ec1);
+                if (ec1) {
+                    // data of later samples is unusable too, stop here
+                    LOG_WARN("[get_samples] fetch failed at " << i << ", ec: " << ec1.message());
+                    samples[i].data.clear();
+                    count = i;
+                    ec = ec1;
+                    break;
+                }
+            }
+            // ec is kept with count, caller sees why the pass stopped
+            if (count) {
+                DemuxStatistic::play_on(samples[count - 1].time);
+                latency_end(beg, boost::system::error_code());
+            } else {
+                DemuxStatistic::last_error(ec);
+                latency_end(beg, ec);
+            }
+            return count;
+        }
+
         bool SingleDemuxer::free_sample(
             Sample & sample, 
             boost::system::error_code & ec)
@@ -86,6 +86,12 @@ namespace just
                 Sample & sample, 
                 boost::system::error_code & ec);
 
+            virtual size_t get_samples(
+                Sample * samples, 
+                size_t max_count, 
+                size_t max_bytes, 
+                boost::system::error_code & ec);
+
             virtual bool free_sample(
                 Sample & sample, 
                 boost::system::error_code & ec);
@@ -98,6 +104,17 @@ namespace just
                 DataStat & stat, 
                 boost::system::error_code & ec) const;
 
+        public:
+            typedef boost::function<
+                bool (std::string const &, boost::uint32_t)> probe_check_type;
+
+            // probe real bytes even with format hint, open fails with not_supported if check says no
+            void set_probe_check(
+                probe_check_type const & check)
+            {
+                probe_check_ = check;
+            }
+
         public:
             just::data::MediaBase const & media() const
             {
@@ -109,6 +126,10 @@ namespace just
                 return *source_;
             }
 
+        protected:
+            virtual void async_prepare_data(
+                sample_response_type const & resp);
+
         private:
             bool create_demuxer(
                 boost::system::error_code & ec);
@@ -135,6 +156,12 @@ namespace just
 
             StateEnum open_state_;
             open_response_type resp_;
+            probe_check_type probe_check_;
+
+        private:
+            // config
+            boost::uint32_t probe_size_; // 2K
+            boost::uint32_t buffer_capacity_; // 10M
         };
 
     } // namespace demux